@@ -1,10 +1,15 @@
 /**
  * @file hash_map_benchmark.cpp
  * @author jian wu (jian.wu_93@foxmail.com)
- * @brief A simple benchmark for jw::hash_map and std::unordered_map
+ * @brief A simple benchmark for jw::hash_map (and its variants) and std::unordered_map
  * Key: int64_t, Value: an array of char, Hasher: _mm_crc32_u64
  * 1. We insert 100,000 element to a map and measure average/max time cost
  * 2. We lookup 100,000 a random key value in the map and measure average/max time cost 
+ * 3. Latencies go to a histogram, we report p50/p90/p99/p99.9 per operation
+ *    as a table, CSV or JSON. With -s N only every Nth operation is timed.
+ * 4. With -d 1 jw::hash_map dumps its stats() to stderr after the lookups
+ *    and again after the erases, probe lengths, rehashes and erase shifts
+ *    need -DHASH_MAP_STATS=ON
  * 
  * @version 0.1
  * @date 2024-02-16
@@ -17,11 +22,21 @@
 #include <iomanip>
 #include <nmmintrin.h> // _mm_crc32_u64
 #include <random>
+#include <string>
+#include <type_traits>
 #include <unistd.h>
 #include <unordered_map>
+#include <vector>
 
 #include <jw/count_allocator.h>
+#include <jw/fastrange_growth_policy.h>
+#include <jw/flat_hash_map.h>
 #include <jw/hash_map.h>
+#include <jw/hugepage_allocator.h>
+#include <jw/incremental_hash_map.h>
+#include <jw/prime_growth_policy.h>
+
+#include "latency_histogram.h"
 
 class stop_watch
 {
@@ -42,10 +57,63 @@ private:
     std::chrono::steady_clock::time_point m_start;
 };
 
+template <typename Map, typename = void>
+struct has_stats : std::false_type
+{ };
+
+template <typename Map>
+struct has_stats<Map, std::void_t<decltype(std::declval<const Map&>().stats())>> : std::true_type
+{ };
+
+void printStats(const std::string &name, const jw::hash_map_stats &s)
+{
+    std::cerr << name << " stats" << std::endl
+              << "  size " << s.size << ", buckets " << s.bucket_count << std::endl
+              << "  displacement mean " << s.mean_displacement << ", max " << s.max_displacement << std::endl
+              << "  clusters (length: count), max " << s.max_cluster << std::endl;
+    for (size_t i = 0; i < s.clusters.size(); ++i)
+    {
+        if (s.clusters[i] != 0)
+        {
+            std::cerr << "    [" << (size_t{1} << i) << ", " << (size_t{2} << i) << "): " << s.clusters[i] << std::endl;
+        }
+    }
+
+    std::cerr << "  finds " << s.finds << " (probe length: count)" << std::endl;
+    for (size_t i = 0; i < s.find_probes.size(); ++i)
+    {
+        if (s.find_probes[i] != 0)
+        {
+            std::cerr << "    " << i << (i + 1 == s.find_probes.size() ? "+" : "") << ": " << s.find_probes[i] << std::endl;
+        }
+    }
+
+    std::cerr << "  rehashes " << s.rehashes << " (" << s.rehash_nanoseconds << " ns)" << std::endl
+              << "  erases " << s.erases << ", shifts " << s.erase_shifts << std::endl;
+}
+
+template <typename Map, typename = void>
+struct has_find_batch : std::false_type
+{ };
+
+template <typename Map>
+struct has_find_batch<Map, std::void_t<decltype(std::declval<Map&>().find_batch(
+    std::declval<const int64_t*>(), std::declval<const int64_t*>(),
+    std::declval<typename Map::iterator*>()))>> : std::true_type
+{ };
+
 void printUsage()
 {
     std::cerr << "hash_map_benchmark" << std::endl
-              << "usage: hash_map_benchmark [-c count] [-i iters] [-r reserved]" << std::endl
+              << "usage: hash_map_benchmark [-c count] [-i iters] [-r reserved] [-t type] [-p policy] [-b batch] [-s sample] [-o format] [-g hugepages] [-d stats]" << std::endl
+              << "  type: 1 jw::hash_map, 2 jw::flat_hash_map, 3 jw::incremental_hash_map, "
+              << "4 std::unordered_map" << std::endl
+              << "  policy (jw::hash_map): 0 power of two, 1 prime, 2 fastrange" << std::endl
+              << "  batch: lookup keys per find_batch call, 0 for scalar find" << std::endl
+              << "  sample: time one operation out of sample (default 1, every operation)" << std::endl
+              << "  format: table (default), csv or json" << std::endl
+              << "  hugepages: 1 to allocate big bucket arrays with jw::hugepage_allocator" << std::endl
+              << "  stats: 1 to dump jw::hash_map stats() to stderr" << std::endl
               << std::endl;
 }
 
@@ -56,9 +124,15 @@ int main(int argc, char *argv[]) {
     size_t iters = 1000000;
     bool callReserve = false;
     int type = -1;
+    int policy = 0;
+    size_t batch = 0;
+    size_t sample = 1;
+    std::string format = "table";
+    bool hugePages = false;
+    bool dumpStats = false;
 
     int opt;
-    while ((opt = getopt(argc, argv, "i:c:r:")) != -1) 
+    while ((opt = getopt(argc, argv, "i:c:r:t:p:b:s:o:g:d:")) != -1) 
     {
         switch (opt) 
         {
@@ -71,6 +145,27 @@ int main(int argc, char *argv[]) {
         case 'r':
             callReserve = std::stol(optarg);
             break;
+        case 't':
+            type = std::stol(optarg);
+            break;
+        case 'p':
+            policy = std::stol(optarg);
+            break;
+        case 'b':
+            batch = std::stol(optarg);
+            break;
+        case 's':
+            sample = std::max(1l, std::stol(optarg));
+            break;
+        case 'o':
+            format = optarg;
+            break;
+        case 'g':
+            hugePages = std::stol(optarg);
+            break;
+        case 'd':
+            dumpStats = std::stol(optarg);
+            break;
         default:
             printUsage();
             break;
@@ -95,6 +190,27 @@ int main(int argc, char *argv[]) {
         }
     };
 
+    struct op_result
+    {
+        std::string name;
+        std::string op;
+        int64_t     mean;
+        int64_t     p50;
+        int64_t     p90;
+        int64_t     p99;
+        int64_t     p999;
+        int64_t     max;
+        uint64_t    samples;
+    };
+    std::vector<op_result> results;
+
+    auto add_result = [&](const std::string &name, const std::string &op, int64_t mean,
+                          const latency_histogram &h)
+    {
+        results.push_back({name, op, mean, h.percentile(0.5), h.percentile(0.9),
+                           h.percentile(0.99), h.percentile(0.999), h.max(), h.count()});
+    };
+
     auto test = [&](const std::string name, auto &m) 
     {
         std::minstd_rand gen(0);
@@ -103,8 +219,23 @@ int main(int argc, char *argv[]) {
         stop_watch watch;
         stop_watch itrWatch;
 
+        // Times one call out of sample, the others only pay for the modulo
+        auto timed = [&](latency_histogram &h, size_t i, auto &&op)
+        {
+            if (i % sample == 0)
+            {
+                itrWatch.start();
+                op();
+                h.record(itrWatch.elapsedTimeNanoseconds());
+            }
+            else
+            {
+                op();
+            }
+        };
+
         watch.start();
-        int64_t maxInsert = 0;
+        latency_histogram insertHist;
 
         jw::count::memory_count::instance()->Reset();
         std::size_t start_mem = jw::count::memory_count::instance()->cur_bytes();
@@ -112,9 +243,7 @@ int main(int argc, char *argv[]) {
         for (size_t i = 0; i < count; ++i) 
         {
             const int64_t val = i + 1;
-            itrWatch.start();
-            m.insert({val, {}});
-            maxInsert = std::max(itrWatch.elapsedTimeNanoseconds(), maxInsert);
+            timed(insertHist, i, [&] { m.insert({val, {}}); });
         }
 
         std::size_t end_mem = jw::count::memory_count::instance()->cur_bytes();
@@ -122,73 +251,244 @@ int main(int argc, char *argv[]) {
 
         int64_t insertDur = watch.elapsedTimeNanoseconds();
 
+        // Keys are drawn before the timed regions, in both lookup modes
+        std::vector<int64_t> keys(iters);
+        for (int64_t &key : keys)
+        {
+            key = ud(gen);
+        }
+
         watch.start();
 
-        int64_t maxLookup = 0;
-        for (size_t i = 0; i < iters; ++i) 
+        latency_histogram lookupHist;
+        if (batch == 0) 
+        {
+            for (size_t i = 0; i < iters; ++i) 
+            {
+                const int64_t val = keys[i];
+                timed(lookupHist, i, [&] { m.find(val); });
+            }
+        }
+        else 
         {
-            const int64_t val = ud(gen);
-            itrWatch.start();
-            m.find(val);
-            maxLookup = std::max(itrWatch.elapsedTimeNanoseconds(), maxLookup);
+            using map_type = std::remove_reference_t<decltype(m)>;
+
+            // A batch records its mean per key once for every key of the batch
+            std::vector<typename map_type::iterator> found(batch, m.end());
+
+            for (size_t i = 0; i < iters; i += batch) 
+            {
+                const size_t n = std::min(batch, iters - i);
+                const int64_t* first = keys.data() + i;
+
+                itrWatch.start();
+                if constexpr (has_find_batch<map_type>::value) 
+                {
+                    m.find_batch(first, first + n, found.data());
+                }
+                else 
+                {
+                    for (size_t k = 0; k < n; ++k) 
+                    {
+                        found[k] = m.find(first[k]);
+                    }
+                }
+                lookupHist.record(itrWatch.elapsedTimeNanoseconds() / static_cast<int64_t>(n), n);
+            }
         }
 
         int64_t lookupDuration = watch.elapsedTimeNanoseconds();
 
+        if constexpr (has_stats<std::remove_reference_t<decltype(m)>>::value)
+        {
+            if (dumpStats)
+            {
+                printStats(name + " after lookups", m.stats());
+            }
+        }
+
+        for (int64_t &key : keys)
+        {
+            key = ud(gen);
+        }
+
         watch.start();
-        int64_t maxErase = 0;
+        latency_histogram eraseHist;
         for (size_t i = 0; i < iters; ++i) 
         {
-            const int64_t val = ud(gen);
-            itrWatch.start();
-            m.erase(val);
-            maxErase = std::max(itrWatch.elapsedTimeNanoseconds(), maxErase);
+            const int64_t val = keys[i];
+            timed(eraseHist, i, [&] { m.erase(val); });
         }
 
         int64_t eraseDuration = watch.elapsedTimeNanoseconds();
 
-        std::cout << std::left << std::setw(20) <<  name << "|"
-                  << std::setw(17) << insertDur / count      << "|" 
-                  << std::setw(17) << maxInsert              << "|"
-                  << std::setw(17) << lookupDuration / iters << "|"
-                  << std::setw(17) << maxLookup              << "|"
-                  << std::setw(17) << eraseDuration / iters  << "|"
-                  << std::setw(17) << maxErase               << "|"
-                  << std::setw(17) << memoryUsed             << std::endl;
+        if constexpr (has_stats<std::remove_reference_t<decltype(m)>>::value)
+        {
+            if (dumpStats)
+            {
+                printStats(name + " after erases", m.stats());
+            }
+        }
+
+        if (format == "table")
+        {
+            std::cout << std::left << std::setw(20) <<  name << "|"
+                      << std::setw(17) << insertDur / count      << "|" 
+                      << std::setw(17) << insertHist.max()       << "|"
+                      << std::setw(17) << lookupDuration / iters << "|"
+                      << std::setw(17) << lookupHist.max()       << "|"
+                      << std::setw(17) << eraseDuration / iters  << "|"
+                      << std::setw(17) << eraseHist.max()        << "|"
+                      << std::setw(17) << memoryUsed             << std::endl;
+        }
+
+        add_result(name, "insert", insertDur / count, insertHist);
+        add_result(name, "lookup", lookupDuration / iters, lookupHist);
+        add_result(name, "delete", eraseDuration / iters, eraseHist);
     };
 
-    std::cout << std::left << std::setw(20) <<  "name" << "|"
-              << std::setw(17) << "insert mean(ns) " << "|" 
-              << std::setw(17) << "insert max(ns) "  << "|"
-              << std::setw(17) << "lookup mean(ns) " << "|"
-              << std::setw(17) << "lookup max(ns) "  << "|"
-              << std::setw(17) << "delete mean(ns) " << "|"
-              << std::setw(17) << "delete max(ns) "  << "|"
-              << std::setw(17) << "Memory(bytes)"    << std::endl;
+    if (format == "table")
+    {
+        std::cout << std::left << std::setw(20) <<  "name" << "|"
+                  << std::setw(17) << "insert mean(ns) " << "|" 
+                  << std::setw(17) << "insert max(ns) "  << "|"
+                  << std::setw(17) << "lookup mean(ns) " << "|"
+                  << std::setw(17) << "lookup max(ns) "  << "|"
+                  << std::setw(17) << "delete mean(ns) " << "|"
+                  << std::setw(17) << "delete max(ns) "  << "|"
+                  << std::setw(17) << "Memory(bytes)"    << std::endl;
+    }
 
-    if (type == -1 || type == 1) 
+    // Every map counts the memory it gets from upstream
+    auto test_all = [&](auto upstream)
     {
-        jw::hash_map<key, 
-                     value, 
-                     hash, 
-                     std::equal_to<>,
-                     jw::count::Allocator<std::pair<key, value>>> hm;
-        if (callReserve)
-            hm.reserve(count);
+        using upstream_type  = decltype(upstream);
+        using pair_allocator = jw::count::Allocator<std::pair<key, value>, upstream_type>;
+        using node_allocator = jw::count::Allocator<std::pair<const key, value>,
+            typename std::allocator_traits<upstream_type>::template rebind_alloc<std::pair<const key, value>>>;
+
+        auto test_hash_map = [&](auto growth_policy)
+        {
+            jw::hash_map<key, 
+                         value, 
+                         hash, 
+                         std::equal_to<>,
+                         pair_allocator,
+                         decltype(growth_policy)> hm;
+            if (callReserve)
+                hm.reserve(count);
         
-        test("jw::hash_map", hm);
-    }
+            test("jw::hash_map", hm);
+        };
+
+        if (type == -1 || type == 1) 
+        {
+            switch (policy) 
+            {
+            case 1:
+                test_hash_map(jw::details::prime_growth_policy<>());
+                break;
+            case 2:
+                // _mm_crc32_u64 only yields 32 bits
+                test_hash_map(jw::details::fastrange_growth_policy<3, 2, 32>());
+                break;
+            default:
+                test_hash_map(jw::details::power_of_two_growth_policy<>());
+                break;
+            }
+        }
+
+        if (type == -1 || type == 2) 
+        {
+            jw::flat_hash_map<key, 
+                              value, 
+                              hash, 
+                              std::equal_to<>,
+                              pair_allocator> hm;
+            if (callReserve)
+                hm.reserve(count);
+        
+            test("jw::flat_hash_map", hm);
+        }
+
+        if (type == -1 || type == 3) 
+        {
+            jw::incremental_hash_map<key, 
+                                     value, 
+                                     hash, 
+                                     std::equal_to<>,
+                                     pair_allocator> hm;
+            if (callReserve)
+                hm.reserve(count);
+        
+            test("jw::incremental_map", hm);
+        }
+
+        if (type == -1 || type == 4) 
+        {
+            std::unordered_map<key, 
+                               value, 
+                               hash,
+                               std::equal_to<>, 
+                               node_allocator> hm;
+            if (callReserve)
+                hm.reserve(count);
+            test("std::unordered_map", hm);
+        }
+    };
+
+    if (hugePages)
+        test_all(jw::hugepage_allocator<std::pair<key, value>>());
+    else
+        test_all(std::allocator<std::pair<key, value>>());
 
-    if (type == -1 || type == 4) 
+    if (format == "csv")
     {
-        std::unordered_map<key, 
-                           value, 
-                           hash,
-                           std::equal_to<>, 
-                           jw::count::Allocator<std::pair<const key, value>>> hm;
-        if (callReserve)
-            hm.reserve(count);
-        test("std::unordered_map", hm);
+        std::cout << "name,op,mean_ns,p50_ns,p90_ns,p99_ns,p999_ns,max_ns,samples" << std::endl;
+        for (const op_result &r : results)
+        {
+            std::cout << r.name << "," << r.op << "," << r.mean << "," << r.p50 << ","
+                      << r.p90 << "," << r.p99 << "," << r.p999 << "," << r.max << ","
+                      << r.samples << std::endl;
+        }
+    }
+    else if (format == "json")
+    {
+        std::cout << "[" << std::endl;
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const op_result &r = results[i];
+            std::cout << "  {\"name\": \"" << r.name << "\", \"op\": \"" << r.op << "\""
+                      << ", \"mean_ns\": " << r.mean << ", \"p50_ns\": " << r.p50
+                      << ", \"p90_ns\": " << r.p90 << ", \"p99_ns\": " << r.p99
+                      << ", \"p999_ns\": " << r.p999 << ", \"max_ns\": " << r.max
+                      << ", \"samples\": " << r.samples << "}"
+                      << (i + 1 < results.size() ? "," : "") << std::endl;
+        }
+        std::cout << "]" << std::endl;
+    }
+    else
+    {
+        std::cout << std::endl
+                  << std::left << std::setw(20) << "name" << "|"
+                  << std::setw(8)  << "op"          << "|"
+                  << std::setw(12) << "p50(ns)"     << "|"
+                  << std::setw(12) << "p90(ns)"     << "|"
+                  << std::setw(12) << "p99(ns)"     << "|"
+                  << std::setw(12) << "p99.9(ns)"   << "|"
+                  << std::setw(12) << "max(ns)"     << "|"
+                  << std::setw(12) << "samples"     << std::endl;
+        for (const op_result &r : results)
+        {
+            std::cout << std::left << std::setw(20) << r.name << "|"
+                      << std::setw(8)  << r.op      << "|"
+                      << std::setw(12) << r.p50     << "|"
+                      << std::setw(12) << r.p90     << "|"
+                      << std::setw(12) << r.p99     << "|"
+                      << std::setw(12) << r.p999    << "|"
+                      << std::setw(12) << r.max     << "|"
+                      << std::setw(12) << r.samples << std::endl;
+        }
     }
 
     return 0;
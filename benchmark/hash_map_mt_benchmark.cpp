@@ -0,0 +1,532 @@
+/**
+ * @file hash_map_mt_benchmark.cpp
+ * @author jian wu (jian.wu_93@foxmail.com)
+ * @brief A multi-threaded benchmark for the concurrent maps
+ * Key: int64_t, Value: an array of char, Hasher: _mm_crc32_u64
+ * 1. We insert count keys into the map
+ * 2. Every thread runs iters operations of a YCSB like mix (reads and updates),
+ *    keys are drawn uniformly or from a (scrambled) zipfian distribution, reads
+ *    miss with a configurable ratio
+ * 3. We report per-thread and aggregate throughput
+ * 4. With -N 1 thread t is bound to NUMA node t % nodes, the sharded maps
+ *    place their shards round robin over the nodes (jw::numa_allocator), and
+ *    we also report the share of hits whose value sits in a page of the
+ *    thread's node (numa_node_of), sampled after the timed loop
+ *
+ * Operations are drawn before the threads start, the timed loop only runs
+ * map operations.
+ *
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ *
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <nmmintrin.h> // _mm_crc32_u64
+#include <random>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+#include <jw/numa_allocator.h>
+#include <jw/replicated_hash_map.h>
+#include <jw/seqlock_hash_map.h>
+#include <jw/sharded_hash_map.h>
+
+class stop_watch
+{
+public:
+    void start()
+    {
+        m_start = std::chrono::steady_clock::now();
+    }
+
+    int64_t elapsedTimeNanoseconds()
+    {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        std::chrono::nanoseconds duration = now - m_start;
+
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+    }
+private:
+    std::chrono::steady_clock::time_point m_start;
+};
+
+/**
+ * @brief Zipfian ranks in [0, n) (Gray et al., "Quickly generating billion-record
+ * synthetic databases"), rank 0 is the most popular. zeta(n) is computed once
+ * and shared by the per-thread generators.
+ */
+class zipfian_distribution
+{
+public:
+    zipfian_distribution(uint64_t n, double theta)
+        : m_n(n), m_theta(theta)
+    {
+        double zeta2 = 0;
+        for (uint64_t i = 1; i <= n; ++i)
+        {
+            m_zetan += 1.0 / std::pow(static_cast<double>(i), theta);
+            if (i == 2)
+            {
+                zeta2 = m_zetan;
+            }
+        }
+
+        m_alpha = 1.0 / (1.0 - theta);
+        m_eta   = (1.0 - std::pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta2 / m_zetan);
+    }
+
+    template <typename Gen>
+    uint64_t operator()(Gen &gen) const
+    {
+        const double u  = std::uniform_real_distribution<double>(0.0, 1.0)(gen);
+        const double uz = u * m_zetan;
+
+        if (uz < 1.0)
+        {
+            return 0;
+        }
+        if (uz < 1.0 + std::pow(0.5, m_theta))
+        {
+            return 1;
+        }
+        return std::min<uint64_t>(m_n - 1,
+            static_cast<uint64_t>(m_n * std::pow(m_eta * u - m_eta + 1.0, m_alpha)));
+    }
+
+private:
+    uint64_t m_n;
+    double   m_theta;
+    double   m_zetan = 0;
+    double   m_alpha = 0;
+    double   m_eta   = 0;
+};
+
+// FNV-1a, spreads the popular zipfian ranks over the key space
+inline uint64_t scramble(uint64_t rank)
+{
+    uint64_t h = 0xCBF29CE484222325ull;
+    for (int i = 0; i < 8; ++i)
+    {
+        h ^= (rank >> (i * 8)) & 0xFF;
+        h *= 0x100000001B3ull;
+    }
+    return h;
+}
+
+using key = int64_t;
+struct value
+{
+    char buf[64];
+};
+
+struct hash {
+    size_t operator()(size_t h) const noexcept
+    {
+        return _mm_crc32_u64(0, h);
+    }
+};
+
+using numa_alloc = jw::numa_allocator<std::pair<key, value>>;
+
+// Reads checked per thread for the page node of their value
+static constexpr const size_t LOCALITY_SAMPLES = 4096;
+
+// Common interface of the benchmarked maps: bool find(key), void update(key, value),
+// const void* address_of(key), where the value read for key is (nullptr on a miss or
+// if the map only hands out copies)
+template <typename Mutex, typename Allocator = std::allocator<std::pair<key, value>>>
+struct sharded_map
+{
+    jw::sharded_hash_map<key, value, hash, std::equal_to<>, Allocator, Mutex> m;
+
+    bool find(key k) const
+    {
+        return m.find(k).has_value();
+    }
+
+    void update(key k, const value &v)
+    {
+        m.insert_or_assign(k, v);
+    }
+
+    const void* address_of(key k) const
+    {
+        const void* p = nullptr;
+        m.visit(k, [&](const value &v) { p = &v; });
+        return p;
+    }
+};
+
+struct replicated_map
+{
+    jw::replicated_hash_map<key, value, hash, std::equal_to<>> m;
+
+    bool find(key k) const
+    {
+        return m.find(k).has_value();
+    }
+
+    void update(key k, const value &v)
+    {
+        m.insert_or_assign(k, v);
+    }
+
+    const void* address_of(key k) const
+    {
+        const void* p = nullptr;
+        m.visit(k, [&](const value &v) { p = &v; });
+        return p;
+    }
+};
+
+struct seqlock_map
+{
+    jw::seqlock_hash_map<key, value, hash, std::equal_to<>> m;
+
+    bool find(key k) const
+    {
+        value v;
+        return m.find(k, v);
+    }
+
+    void update(key k, const value &v)
+    {
+        m.insert_or_assign(k, v);
+    }
+
+    const void* address_of(key) const
+    {
+        return nullptr;
+    }
+};
+
+struct locked_unordered_map
+{
+    mutable std::mutex                     mutex;
+    std::unordered_map<key, value, hash>   m;
+
+    bool find(key k) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = m.find(k);
+        if (it == m.end())
+        {
+            return false;
+        }
+        value v = it->second;
+        (void)v;
+        return true;
+    }
+
+    void update(key k, const value &v)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        m[k] = v;
+    }
+
+    const void* address_of(key k) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = m.find(k);
+        return it == m.end() ? nullptr : &it->second;
+    }
+};
+
+struct operation
+{
+    key  k;
+    bool read;
+};
+
+struct thread_result
+{
+    int64_t duration    = 0;
+    size_t  reads       = 0;
+    size_t  hits        = 0;
+    size_t  local_hits  = 0;
+    size_t  remote_hits = 0;
+    int     node        = 0;
+};
+
+// Share of the sampled hits in pages of the thread's node, "-" when unknown
+std::string local_ratio(size_t local_hits, size_t remote_hits)
+{
+    if (local_hits + remote_hits == 0)
+    {
+        return "-";
+    }
+    return std::to_string(100.0 * local_hits / (local_hits + remote_hits));
+}
+
+void printUsage()
+{
+    std::cerr << "hash_map_mt_benchmark" << std::endl
+              << "usage: hash_map_mt_benchmark [-n threads] [-c count] [-i iters] [-w workload] "
+              << "[-d distribution] [-z theta] [-h hit] [-t type] [-N numa]" << std::endl
+              << "  iters: operations per thread" << std::endl
+              << "  workload: a (50% reads), b (95% reads), c (100% reads) or a read percentage" << std::endl
+              << "  distribution: u uniform, z zipfian" << std::endl
+              << "  hit: percentage of reads of a key in the map" << std::endl
+              << "  type: 1 jw::sharded_hash_map (std::shared_mutex), 2 jw::sharded_hash_map (jw::spinlock), "
+              << "3 jw::seqlock_hash_map, 4 std::unordered_map + std::mutex, 5 jw::replicated_hash_map" << std::endl
+              << "  numa: 1 binds the threads round robin to the NUMA nodes, places the shards on the nodes "
+              << "and reports local hits" << std::endl
+              << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    size_t count = 1000000;
+    size_t iters = 1000000;
+    int readPercent = 50;
+    std::string workload = "a";
+    bool zipf = false;
+    double theta = 0.99;
+    int hitPercent = 100;
+    int type = -1;
+    bool numa = false;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:c:i:w:d:z:h:t:N:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'n':
+            threads = std::max(1l, std::stol(optarg));
+            break;
+        case 'c':
+            count = std::max(1l, std::stol(optarg));
+            break;
+        case 'i':
+            iters = std::stol(optarg);
+            break;
+        case 'w':
+            workload = optarg;
+            break;
+        case 'd':
+            zipf = optarg[0] == 'z';
+            break;
+        case 'z':
+            theta = std::stod(optarg);
+            break;
+        case 'h':
+            hitPercent = std::stol(optarg);
+            break;
+        case 't':
+            type = std::stol(optarg);
+            break;
+        case 'N':
+            numa = std::stol(optarg) != 0;
+            break;
+        default:
+            printUsage();
+            exit(1);
+        }
+    }
+
+    if (optind != argc) {
+        printUsage();
+        exit(1);
+    }
+
+    if (workload == "a")
+        readPercent = 50;
+    else if (workload == "b")
+        readPercent = 95;
+    else if (workload == "c")
+        readPercent = 100;
+    else
+        readPercent = std::stol(workload);
+
+    // Keys of the map are 1..count, misses are drawn above count
+    std::vector<std::vector<operation>> ops(threads);
+    {
+        zipfian_distribution zd(count, theta);
+        for (size_t t = 0; t < threads; ++t)
+        {
+            std::mt19937_64 gen(t + 1);
+            std::uniform_int_distribution<uint64_t> ud(0, count - 1);
+            std::uniform_int_distribution<int> percent(0, 99);
+
+            ops[t].resize(iters);
+            for (operation &op : ops[t])
+            {
+                const uint64_t rank = zipf ? scramble(zd(gen)) % count : ud(gen);
+                op.read = percent(gen) < readPercent;
+                op.k    = static_cast<key>(rank + 1);
+                if (op.read && percent(gen) >= hitPercent)
+                {
+                    op.k += count;
+                }
+            }
+        }
+    }
+
+    std::cout << "threads: " << threads << ", keys: " << count << ", ops/thread: " << iters
+              << ", reads: " << readPercent << "%, hits: " << hitPercent << "%, keys: "
+              << (zipf ? "zipfian theta " + std::to_string(theta) : std::string("uniform"))
+              << ", numa nodes: " << (numa ? std::to_string(jw::numa_node_count()) : std::string("not bound"))
+              << std::endl;
+
+    auto test = [&](const std::string name, auto &m)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            m.update(static_cast<key>(i + 1), value{});
+        }
+
+        std::vector<thread_result> results(threads);
+        std::vector<std::thread>   workers;
+        std::atomic<size_t>        ready{0};
+        std::atomic<bool>          go{false};
+
+        for (size_t t = 0; t < threads; ++t)
+        {
+            workers.emplace_back([&, t]
+            {
+                const value v{};
+                thread_result res;
+                if (numa)
+                {
+                    jw::numa_bind_thread(static_cast<int>(t % jw::numa_node_count()));
+                }
+                res.node = jw::numa_current_node();
+
+                ready.fetch_add(1);
+                while (!go.load(std::memory_order_acquire))
+                {
+                    std::this_thread::yield();
+                }
+
+                stop_watch watch;
+                watch.start();
+                for (const operation &op : ops[t])
+                {
+                    if (op.read)
+                    {
+                        ++res.reads;
+                        res.hits += m.find(op.k);
+                    }
+                    else
+                    {
+                        m.update(op.k, v);
+                    }
+                }
+                res.duration = watch.elapsedTimeNanoseconds();
+
+                // Where the pages of the values really are, the kernel may
+                // have placed them elsewhere than the allocator asked
+                if (numa)
+                {
+                    const size_t stride = std::max<size_t>(1, ops[t].size() / LOCALITY_SAMPLES);
+                    for (size_t i = 0; i < ops[t].size(); i += stride)
+                    {
+                        const void* p = ops[t][i].read ? m.address_of(ops[t][i].k) : nullptr;
+                        const int node = p ? jw::numa_node_of(p) : jw::NO_NUMA_NODE;
+                        res.local_hits  += node != jw::NO_NUMA_NODE && node == res.node;
+                        res.remote_hits += node != jw::NO_NUMA_NODE && node != res.node;
+                    }
+                }
+                results[t] = res;
+            });
+        }
+
+        while (ready.load() != threads)
+        {
+            std::this_thread::yield();
+        }
+        go.store(true, std::memory_order_release);
+
+        for (std::thread &w : workers)
+        {
+            w.join();
+        }
+
+        int64_t wall        = 1;
+        size_t  reads       = 0;
+        size_t  hits        = 0;
+        size_t  local_hits  = 0;
+        size_t  remote_hits = 0;
+        for (size_t t = 0; t < threads; ++t)
+        {
+            const thread_result &res = results[t];
+            wall   = std::max(wall, res.duration);
+            reads += res.reads;
+            hits  += res.hits;
+            local_hits  += res.local_hits;
+            remote_hits += res.remote_hits;
+
+            std::cout << std::left << std::setw(48)
+                      << name + " thread " + std::to_string(t) + (numa ? " node " + std::to_string(res.node) : "") << "|"
+                      << std::setw(17) << static_cast<int64_t>(iters * 1e9 / std::max<int64_t>(res.duration, 1)) << "|"
+                      << std::setw(17) << res.duration / std::max<size_t>(iters, 1) << "|"
+                      << std::setw(17) << (res.reads ? 100.0 * res.hits / res.reads : 0.0) << "|"
+                      << std::setw(17) << local_ratio(res.local_hits, res.remote_hits) << std::endl;
+        }
+
+        std::cout << std::left << std::setw(48) << name + " total" << "|"
+                  << std::setw(17) << static_cast<int64_t>(threads * iters * 1e9 / wall) << "|"
+                  << std::setw(17) << "" << "|"
+                  << std::setw(17) << (reads ? 100.0 * hits / reads : 0.0) << "|"
+                  << std::setw(17) << local_ratio(local_hits, remote_hits) << std::endl;
+    };
+
+    std::cout << std::left << std::setw(48) << "name" << "|"
+              << std::setw(17) << "ops/sec" << "|"
+              << std::setw(17) << "op mean(ns)" << "|"
+              << std::setw(17) << "hit ratio(%)" << "|"
+              << std::setw(17) << "local hits(%)" << std::endl;
+
+    if ((type == -1 || type == 1) && numa)
+    {
+        sharded_map<std::shared_mutex, numa_alloc> m;
+        test("jw::sharded_hash_map<std::shared_mutex>", m);
+    }
+    else if (type == -1 || type == 1)
+    {
+        sharded_map<std::shared_mutex> m;
+        test("jw::sharded_hash_map<std::shared_mutex>", m);
+    }
+
+    if ((type == -1 || type == 2) && numa)
+    {
+        sharded_map<jw::spinlock, numa_alloc> m;
+        test("jw::sharded_hash_map<jw::spinlock>", m);
+    }
+    else if (type == -1 || type == 2)
+    {
+        sharded_map<jw::spinlock> m;
+        test("jw::sharded_hash_map<jw::spinlock>", m);
+    }
+
+    if (type == -1 || type == 3)
+    {
+        seqlock_map m;
+        test("jw::seqlock_hash_map", m);
+    }
+
+    if (type == -1 || type == 4)
+    {
+        locked_unordered_map m;
+        test("std::unordered_map + std::mutex", m);
+    }
+
+    if (type == -1 || type == 5)
+    {
+        replicated_map m;
+        test("jw::replicated_hash_map", m);
+    }
+
+    return 0;
+}
@@ -0,0 +1,333 @@
+/**
+ * @file hash_map_suite.cpp
+ * @author jian wu (jian.wu_93@foxmail.com)
+ * @brief Google Benchmark suite over a matrix of key types, value sizes,
+ * table sizes and lookup hit rates.
+ *
+ * Keys: int32_t, int64_t, short std::string (SSO), long std::string, 16 bytes struct
+ * Values: 0, 8, 64 and 256 bytes
+ * Table sizes: the number of elements is picked so the elements take about
+ * 16 KiB (L1), 512 KiB (L2), 16 MiB (LLC) and 256 MiB (beyond LLC)
+ * Hit rates (lookup): 0%, 50%, 100%
+ *
+ * Every map uses the same hasher. abseil flat_hash_map, ankerl::unordered_dense
+ * and tsl::robin_map baselines are built when they were found by cmake.
+ *
+ * Benchmarks are named op/map/key/value/elements[/hit%], use
+ * --benchmark_filter to pick a slice of the matrix, e.g.
+ * hash_map_suite --benchmark_filter='lookup/jw::hash_map/int64/8B/'
+ *
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ *
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include <jw/dense_hash_map.h>
+#include <jw/flat_hash_map.h>
+#include <jw/hash_map.h>
+#include <jw/incremental_hash_map.h>
+#include <jw/small_hash_map.h>
+
+#ifdef JW_HAVE_ABSL
+#include <absl/container/flat_hash_map.h>
+#endif
+
+#ifdef JW_HAVE_UNORDERED_DENSE
+#include <ankerl/unordered_dense.h>
+#endif
+
+#ifdef JW_HAVE_TSL_ROBIN_MAP
+#include <tsl/robin_map.h>
+#endif
+
+namespace
+{
+
+struct key16
+{
+    uint64_t a;
+    uint64_t b;
+
+    bool operator==(const key16 &other) const noexcept
+    {
+        return a == other.a && b == other.b;
+    }
+};
+
+template <std::size_t N>
+struct blob
+{
+    char buf[N];
+};
+
+template <>
+struct blob<0>
+{ };
+
+inline uint64_t mix(uint64_t h) noexcept
+{
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+// Same hasher for every map, integers are mixed so the power of two tables
+// don't depend on the key pattern. Tagged is_avalanching, the maps which
+// would mix it again (jw::hash_map, ankerl) use it as is
+template <typename K>
+struct suite_hash
+{
+    using is_avalanching = void;
+
+    std::size_t operator()(const K &k) const noexcept
+    {
+        return mix(static_cast<uint64_t>(k));
+    }
+};
+
+template <>
+struct suite_hash<std::string>
+{
+    using is_avalanching = void;
+
+    std::size_t operator()(const std::string &k) const noexcept
+    {
+        return std::hash<std::string>()(k);
+    }
+};
+
+template <>
+struct suite_hash<key16>
+{
+    using is_avalanching = void;
+
+    std::size_t operator()(const key16 &k) const noexcept
+    {
+        return mix(k.a ^ mix(k.b));
+    }
+};
+
+struct short_string
+{
+    using type = std::string;
+    static constexpr const char* name = "short_string";
+};
+
+struct long_string
+{
+    using type = std::string;
+    static constexpr const char* name = "long_string";
+};
+
+struct int32_key
+{
+    using type = int32_t;
+    static constexpr const char* name = "int32";
+};
+
+struct int64_key
+{
+    using type = int64_t;
+    static constexpr const char* name = "int64";
+};
+
+struct struct_key
+{
+    using type = key16;
+    static constexpr const char* name = "key16";
+};
+
+// Distinct keys for distinct i, never the default constructed key (the
+// empty key of jw::hash_map)
+template <typename KeyTag>
+typename KeyTag::type make_key(uint64_t i)
+{
+    using K = typename KeyTag::type;
+    if constexpr (std::is_same<KeyTag, short_string>::value)
+    {
+        return "k" + std::to_string(i);
+    }
+    else if constexpr (std::is_same<KeyTag, long_string>::value)
+    {
+        return std::string(40, 'x') + std::to_string(i);
+    }
+    else if constexpr (std::is_same<K, key16>::value)
+    {
+        return key16{i + 1, mix(i)};
+    }
+    else
+    {
+        return static_cast<K>(i + 1);
+    }
+}
+
+template <typename KeyTag>
+std::vector<typename KeyTag::type> make_keys(uint64_t first, std::size_t n)
+{
+    std::vector<typename KeyTag::type> keys;
+    keys.reserve(n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        keys.push_back(make_key<KeyTag>(first + i));
+    }
+    return keys;
+}
+
+// Keys are made when the benchmark runs, not when it is registered
+template <typename Map, typename KeyTag>
+void bm_insert(benchmark::State &state, std::size_t n)
+{
+    using mapped = typename Map::mapped_type;
+
+    const auto keys = make_keys<KeyTag>(0, n);
+
+    for (auto _ : state)
+    {
+        Map m;
+        for (const auto &k : keys)
+        {
+            m.emplace(k, mapped{});
+        }
+        benchmark::DoNotOptimize(m);
+    }
+
+    state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+template <typename Map, typename KeyTag>
+void bm_lookup(benchmark::State &state, std::size_t n, int hit_percent)
+{
+    using key_type = typename Map::key_type;
+    using mapped   = typename Map::mapped_type;
+
+    const auto keys   = make_keys<KeyTag>(0, n);
+    const auto misses = make_keys<KeyTag>(n, n);
+
+    Map m;
+    for (const auto &k : keys)
+    {
+        m.emplace(k, mapped{});
+    }
+
+    // hit_percent of the probes are keys of the map, in random order
+    std::vector<key_type> probes;
+    probes.reserve(keys.size());
+    for (std::size_t i = 0; i < keys.size(); ++i)
+    {
+        probes.push_back(static_cast<int>(i % 100) < hit_percent ? keys[i] : misses[i]);
+    }
+    std::shuffle(probes.begin(), probes.end(), std::mt19937_64(1));
+
+    std::size_t i = 0;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(m.find(probes[i]) != m.end());
+        if (++i == probes.size())
+        {
+            i = 0;
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations());
+}
+
+static constexpr const std::size_t FOOTPRINTS[] = {
+    std::size_t{16} << 10,
+    std::size_t{512} << 10,
+    std::size_t{16} << 20,
+    std::size_t{256} << 20,
+};
+
+static constexpr const int HIT_PERCENTS[] = {0, 50, 100};
+
+template <typename Map, typename KeyTag, std::size_t ValueSize>
+void register_map(const std::string &map_name)
+{
+    using key_type = typename KeyTag::type;
+
+    const std::string suffix = map_name + "/" + KeyTag::name + "/" + std::to_string(ValueSize) + "B/";
+
+    for (std::size_t footprint : FOOTPRINTS)
+    {
+        const std::size_t n = std::max<std::size_t>(
+            16, footprint / sizeof(std::pair<key_type, blob<ValueSize>>));
+
+        benchmark::RegisterBenchmark(("insert/" + suffix + std::to_string(n)).c_str(),
+                                     bm_insert<Map, KeyTag>, n)
+            ->Unit(benchmark::kMicrosecond);
+
+        for (int hit : HIT_PERCENTS)
+        {
+            benchmark::RegisterBenchmark(
+                ("lookup/" + suffix + std::to_string(n) + "/" + std::to_string(hit)).c_str(),
+                bm_lookup<Map, KeyTag>, n, hit);
+        }
+    }
+}
+
+template <typename KeyTag, std::size_t ValueSize>
+void register_maps()
+{
+    using K = typename KeyTag::type;
+    using V = blob<ValueSize>;
+    using H = suite_hash<K>;
+
+    register_map<jw::hash_map<K, V, H>, KeyTag, ValueSize>("jw::hash_map");
+    register_map<jw::flat_hash_map<K, V, H>, KeyTag, ValueSize>("jw::flat_hash_map");
+    register_map<jw::incremental_hash_map<K, V, H>, KeyTag, ValueSize>("jw::incremental_hash_map");
+    register_map<jw::small_hash_map<K, V, 8, H>, KeyTag, ValueSize>("jw::small_hash_map");
+    register_map<jw::dense_hash_map<K, V, H>, KeyTag, ValueSize>("jw::dense_hash_map");
+    register_map<std::unordered_map<K, V, H>, KeyTag, ValueSize>("std::unordered_map");
+#ifdef JW_HAVE_ABSL
+    register_map<absl::flat_hash_map<K, V, H>, KeyTag, ValueSize>("absl::flat_hash_map");
+#endif
+#ifdef JW_HAVE_UNORDERED_DENSE
+    register_map<ankerl::unordered_dense::map<K, V, H>, KeyTag, ValueSize>("ankerl::unordered_dense::map");
+#endif
+#ifdef JW_HAVE_TSL_ROBIN_MAP
+    register_map<tsl::robin_map<K, V, H>, KeyTag, ValueSize>("tsl::robin_map");
+#endif
+}
+
+template <typename KeyTag>
+void register_value_sizes()
+{
+    register_maps<KeyTag, 0>();
+    register_maps<KeyTag, 8>();
+    register_maps<KeyTag, 64>();
+    register_maps<KeyTag, 256>();
+}
+
+}
+
+int main(int argc, char **argv)
+{
+    register_value_sizes<int32_key>();
+    register_value_sizes<int64_key>();
+    register_value_sizes<short_string>();
+    register_value_sizes<long_string>();
+    register_value_sizes<struct_key>();
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,120 @@
+/**
+ * @file latency_histogram.h
+ * @author jian wu (jian.wu_93@foxmail.com)
+ * @brief Log-linear latency histogram (HDR-style) for the benchmarks.
+ *
+ * Values are bucketed by their highest set bit, each power of two range is
+ * split into SUB_BUCKETS linear buckets, so the relative error of a percentile
+ * is below 1 / SUB_BUCKETS (~3%) over the whole int64_t range. Recording is a
+ * clz, a shift and an increment, max and sum are exact.
+ *
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+class latency_histogram
+{
+public:
+    static constexpr const int      SUB_BUCKET_BITS = 5;
+    static constexpr const uint64_t SUB_BUCKETS     = uint64_t{1} << SUB_BUCKET_BITS;
+    static constexpr const size_t   BUCKET_COUNT    = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    void record(int64_t value, uint64_t count = 1) noexcept
+    {
+        const uint64_t v = static_cast<uint64_t>(std::max<int64_t>(value, 0));
+
+        m_counts[bucket_index(v)] += count;
+        m_count += count;
+        m_sum   += v * count;
+        m_max    = std::max(m_max, v);
+        m_min    = std::min(m_min, v);
+    }
+
+    uint64_t count() const noexcept
+    {
+        return m_count;
+    }
+
+    int64_t max() const noexcept
+    {
+        return static_cast<int64_t>(m_max);
+    }
+
+    int64_t min() const noexcept
+    {
+        return m_count ? static_cast<int64_t>(m_min) : 0;
+    }
+
+    double mean() const noexcept
+    {
+        return m_count ? static_cast<double>(m_sum) / m_count : 0.0;
+    }
+
+    // Upper bound of the bucket holding the q-th quantile, q in [0, 1]
+    int64_t percentile(double q) const noexcept
+    {
+        if (m_count == 0)
+        {
+            return 0;
+        }
+
+        const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(q * m_count + 0.5));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKET_COUNT; ++i)
+        {
+            seen += m_counts[i];
+            if (seen >= rank)
+            {
+                return static_cast<int64_t>(std::min(bucket_upper_bound(i), m_max));
+            }
+        }
+        return max();
+    }
+
+    void reset() noexcept
+    {
+        *this = latency_histogram();
+    }
+
+private:
+    // Values below SUB_BUCKETS get a bucket each, above the bucket is the
+    // highest set bit followed by the next SUB_BUCKET_BITS bits
+    static size_t bucket_index(uint64_t v) noexcept
+    {
+        if (v < SUB_BUCKETS)
+        {
+            return static_cast<size_t>(v);
+        }
+
+        const int msb   = 63 - __builtin_clzll(v);
+        const int shift = msb - SUB_BUCKET_BITS;
+        return static_cast<size_t>((shift + 1) * SUB_BUCKETS + ((v >> shift) - SUB_BUCKETS));
+    }
+
+    static uint64_t bucket_upper_bound(size_t i) noexcept
+    {
+        if (i < SUB_BUCKETS)
+        {
+            return i;
+        }
+
+        const int      shift = static_cast<int>(i / SUB_BUCKETS) - 1;
+        const uint64_t sub   = i % SUB_BUCKETS + SUB_BUCKETS;
+        return ((sub + 1) << shift) - 1;
+    }
+
+    std::array<uint64_t, BUCKET_COUNT> m_counts{};
+    uint64_t m_count = 0;
+    uint64_t m_sum   = 0;
+    uint64_t m_max   = 0;
+    uint64_t m_min   = std::numeric_limits<uint64_t>::max();
+};
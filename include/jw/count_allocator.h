@@ -2,123 +2,343 @@
  * @file count_allocator.h
  * @author jian wu (jian.wu_93@foxmail.com)
  * @brief Custome allocator(mainly for memory allocated measurement)
+ *
+ * Every count_allocator reports to a memory_count, the global instance() by
+ * default, or one given to the allocator to account a map (or a group of maps)
+ * on its own. Counters are kept per thread (one cache line per thread slot)
+ * and summed on read, so allocating threads don't contend.
+ *
+ * peak_bytes() is refreshed on every allocation of at least PEAK_SAMPLE_BYTES
+ * (bucket arrays, which make the spikes) and on every read of cur_bytes(), the
+ * peak of many small allocations in between is not seen.
+ *
+ * With enable_tracing() every allocation and deallocation is also recorded,
+ * with a timestamp, in a ring buffer of the last capacity events.
+ *
  * @version 0.1
  * @date 2024-02-16
- * 
- * 
+ *
+ *
  */
 #pragma once
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
 
-namespace jw::count 
+namespace jw::count
 {
 
-template<typename T>
+template<typename T, typename Upstream>
 class count_allocator;
 
-class memory_count 
+struct allocation_event
+{
+    int64_t     timestamp; // steady_clock, nanoseconds
+    std::size_t bytes;
+    const void* ptr;
+    bool        allocation;
+};
+
+class memory_count
 {
 public:
+    static constexpr const std::size_t THREAD_SLOTS      = 64;
+    static constexpr const std::size_t PEAK_SAMPLE_BYTES = 1 << 12; // 4KB
+
+    explicit memory_count(std::string tag = std::string()) : m_tag(std::move(tag))
+    { }
+
     memory_count(const memory_count&) = delete;
     memory_count(memory_count&&)      = delete;
 
     memory_count& operator=(const memory_count&) = delete;
     memory_count& operator=(memory_count&&)      = delete;
 
-    template<class T> friend class count_allocator;
+    template<class T, class Upstream> friend class count_allocator;
 
-    static memory_count* instance() 
+    static memory_count* instance()
     {
-        static memory_count* instance_ = new memory_count();
+        static memory_count* instance_ = new memory_count("global");
 
         return instance_;
     }
 
-    void ResetPeakBytes() 
+    const std::string& tag() const noexcept
+    {
+        return m_tag;
+    }
+
+    void ResetPeakBytes()
+    {
+        m_peakBytes.store(0, std::memory_order_relaxed);
+    }
+
+    size_t cur_bytes() const
+    {
+        const size_t bytes = sum(&thread_counters::m_curBytes);
+        update_peak(bytes);
+        return bytes;
+    }
+
+    size_t peak_bytes() const
+    {
+        return std::max(m_peakBytes.load(std::memory_order_relaxed), cur_bytes());
+    }
+
+    size_t alloc_count() const
     {
-        m_peakBytes = 0;
+        return sum(&thread_counters::m_allocs);
     }
 
-    size_t cur_bytes() const 
+    size_t dealloc_count() const
     {
-        return m_curBytes;
+        return sum(&thread_counters::m_deallocs);
     }
 
-    size_t peak_bytes() const 
+    // Bytes ever allocated, deallocated
+    size_t alloc_bytes() const
     {
-        return m_peakBytes;
+        return sum(&thread_counters::m_allocBytes);
     }
 
+    size_t dealloc_bytes() const
+    {
+        return sum(&thread_counters::m_deallocBytes);
+    }
+
+    // Not synchronized with allocations running at the same time
     void Reset()
     {
-        m_peakBytes = 0;
-        m_curBytes = 0;
+        for (thread_counters& c : m_counters)
+        {
+            c.m_curBytes.store(0, std::memory_order_relaxed);
+            c.m_allocs.store(0, std::memory_order_relaxed);
+            c.m_deallocs.store(0, std::memory_order_relaxed);
+            c.m_allocBytes.store(0, std::memory_order_relaxed);
+            c.m_deallocBytes.store(0, std::memory_order_relaxed);
+        }
+        m_peakBytes.store(0, std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> lock(m_eventsMutex);
+        m_eventCount = 0;
+    }
+
+    // Records the last capacity events, 0 disables tracing
+    void enable_tracing(std::size_t capacity)
+    {
+        std::lock_guard<std::mutex> lock(m_eventsMutex);
+        m_events.assign(capacity, allocation_event{});
+        m_eventCount = 0;
+        m_tracing.store(capacity != 0, std::memory_order_relaxed);
+    }
+
+    // Recorded events, oldest first
+    std::vector<allocation_event> events() const
+    {
+        std::lock_guard<std::mutex> lock(m_eventsMutex);
+
+        std::vector<allocation_event> res;
+        const std::size_t capacity = m_events.size();
+        const std::size_t n = std::min<std::size_t>(m_eventCount, capacity);
+        res.reserve(n);
+        for (std::size_t i = m_eventCount - n; i < m_eventCount; ++i)
+        {
+            res.push_back(m_events[i % capacity]);
+        }
+        return res;
     }
+
 private:
-    memory_count(): m_curBytes(0), m_peakBytes(0) {};
-    size_t m_curBytes;
-    size_t m_peakBytes;
+    struct alignas(64) thread_counters
+    {
+        std::atomic<int64_t> m_curBytes{0};
+        std::atomic<int64_t> m_allocs{0};
+        std::atomic<int64_t> m_deallocs{0};
+        std::atomic<int64_t> m_allocBytes{0};
+        std::atomic<int64_t> m_deallocBytes{0};
+    };
+
+    // Memory freed by another thread than the one which allocated it makes
+    // single slots negative, only the sum is meaningful
+    size_t sum(std::atomic<int64_t> thread_counters::* counter) const
+    {
+        int64_t total = 0;
+        for (const thread_counters& c : m_counters)
+        {
+            total += (c.*counter).load(std::memory_order_relaxed);
+        }
+        return static_cast<size_t>(std::max<int64_t>(total, 0));
+    }
+
+    void update_peak(size_t bytes) const
+    {
+        size_t peak = m_peakBytes.load(std::memory_order_relaxed);
+        while (bytes > peak &&
+               !m_peakBytes.compare_exchange_weak(peak, bytes, std::memory_order_relaxed))
+        { }
+    }
+
+    thread_counters& local_counters()
+    {
+        static std::atomic<std::size_t> next_slot{0};
+        thread_local const std::size_t slot =
+            next_slot.fetch_add(1, std::memory_order_relaxed) % THREAD_SLOTS;
+        return m_counters[slot];
+    }
+
+    void UseMemory(const void* p, size_t bytes)
+    {
+        thread_counters& c = local_counters();
+        c.m_curBytes.fetch_add(static_cast<int64_t>(bytes), std::memory_order_relaxed);
+        c.m_allocs.fetch_add(1, std::memory_order_relaxed);
+        c.m_allocBytes.fetch_add(static_cast<int64_t>(bytes), std::memory_order_relaxed);
+
+        if (bytes >= PEAK_SAMPLE_BYTES)
+        {
+            update_peak(sum(&thread_counters::m_curBytes));
+        }
+
+        trace(p, bytes, true);
+    }
 
-    void UseMemory(size_t bytes) 
+    void ReclaimMemory(const void* p, size_t bytes)
     {
-        m_curBytes += bytes;
-        m_peakBytes = std::max(m_curBytes, m_peakBytes);
+        thread_counters& c = local_counters();
+        c.m_curBytes.fetch_sub(static_cast<int64_t>(bytes), std::memory_order_relaxed);
+        c.m_deallocs.fetch_add(1, std::memory_order_relaxed);
+        c.m_deallocBytes.fetch_add(static_cast<int64_t>(bytes), std::memory_order_relaxed);
+
+        trace(p, bytes, false);
     }
 
-    void ReclaimMemory(size_t bytes) 
+    void trace(const void* p, size_t bytes, bool allocation)
     {
-        m_curBytes -= bytes;
+        if (!m_tracing.load(std::memory_order_relaxed))
+        {
+            return;
+        }
+
+        const int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+
+        std::lock_guard<std::mutex> lock(m_eventsMutex);
+        if (!m_events.empty())
+        {
+            m_events[m_eventCount++ % m_events.size()] = allocation_event{now, bytes, p, allocation};
+        }
     }
 
+    std::string                   m_tag;
+    thread_counters               m_counters[THREAD_SLOTS];
+    mutable std::atomic<size_t>   m_peakBytes{0};
+
+    std::atomic<bool>             m_tracing{false};
+    mutable std::mutex            m_eventsMutex;
+    std::vector<allocation_event> m_events;
+    std::size_t                   m_eventCount = 0;
 };
 
-template <typename T>
-class count_allocator 
+// Counts the memory allocated by Upstream (e.g. jw::hugepage_allocator)
+template <typename T, typename Upstream = std::allocator<T>>
+class count_allocator
 {
-public:
-    constexpr static std::size_t HUGE_PAGE_SIZE            = 1 << 21; // 2 MiB
-    constexpr static std::size_t ALLOC_HUGE_PAGE_THRESHOLD = 1 << 16; // 64KB
+    using upstream_traits = std::allocator_traits<Upstream>;
 
+public:
     using value_type = T;
 
-    count_allocator() = default;
+    // Propagates like Upstream, the counter moves along
+    using propagate_on_container_copy_assignment = typename upstream_traits::propagate_on_container_copy_assignment;
+    using propagate_on_container_move_assignment = typename upstream_traits::propagate_on_container_move_assignment;
+    using propagate_on_container_swap            = typename upstream_traits::propagate_on_container_swap;
 
     template <class U>
-    constexpr count_allocator(const count_allocator<U> &) noexcept 
+    struct rebind
+    {
+        using other = count_allocator<U, typename upstream_traits::template rebind_alloc<U>>;
+    };
+
+    count_allocator() noexcept : m_count(memory_count::instance())
+    { }
+
+    // Accounts to counter instead of the global instance
+    explicit count_allocator(memory_count &counter) noexcept : m_count(&counter)
+    { }
+
+    // Accounts to counter the memory allocated by upstream (e.g. a
+    // jw::numa_allocator bound to a node)
+    count_allocator(memory_count &counter, const Upstream &upstream) noexcept
+        : m_upstream(upstream), m_count(&counter)
+    { }
+
+    template <class U, class UpstreamU>
+    constexpr count_allocator(const count_allocator<U, UpstreamU> &other) noexcept
+        : m_upstream(other.m_upstream), m_count(other.m_count)
     { }
 
     count_allocator(const count_allocator&) = default;
 
-    friend bool operator==(const count_allocator&, const count_allocator&) 
+    friend bool operator==(const count_allocator &a, const count_allocator &b)
     {
-        return true;
+        return a.m_count == b.m_count;
     }
 
-    value_type* allocate(std::size_t n) 
+    friend bool operator!=(const count_allocator &a, const count_allocator &b)
     {
-        void* p = m_std_allocator.allocate(n);
+        return !(a == b);
+    }
 
-        size_t used_bytes = n * sizeof(value_type);
-        memory_count::instance()->UseMemory(used_bytes);
+    value_type* allocate(std::size_t n)
+    {
+        void* p = upstream_traits::allocate(m_upstream, n);
 
         if (p == nullptr)
             throw std::bad_alloc();
 
+        size_t used_bytes = n * sizeof(value_type);
+        m_count->UseMemory(p, used_bytes);
+
         return static_cast<value_type*>(p);
     }
 
-    void deallocate(T* p, std::size_t n) 
+    void deallocate(T* p, std::size_t n)
     {
-        m_std_allocator.deallocate(p, n);
         size_t bytes_num = n * sizeof(value_type);
-        memory_count::instance()->ReclaimMemory(bytes_num);
+        m_count->ReclaimMemory(p, bytes_num);
+        upstream_traits::deallocate(m_upstream, p, n);
     }
+
+    // Same counter, upstream bound to node, for the NUMA placement of
+    // jw::sharded_hash_map and jw::replicated_hash_map
+    template <typename U = Upstream>
+    auto on_node(int node) const -> decltype(std::declval<const U&>().on_node(node), count_allocator())
+    {
+        return count_allocator(*m_count, m_upstream.on_node(node));
+    }
+
+    memory_count* counter() const noexcept
+    {
+        return m_count;
+    }
+
 private:
-    std::allocator<value_type> m_std_allocator;
+    template <typename U, typename UpstreamU> friend class count_allocator;
+
+    Upstream      m_upstream;
+    memory_count* m_count;
 };
 
-template<class T>
-using Allocator = count_allocator<T>;
+template<class T, class Upstream = std::allocator<T>>
+using Allocator = count_allocator<T, Upstream>;
 
 }
@@ -0,0 +1,683 @@
+/**
+ * @file dense_hash_map.h
+ * @author jian wu (jian.wu_93@foxmail.com)
+ * @brief Hash map keeping its values packed in a std::vector, in insertion
+ * order. The open addressing table (Robin Hood, linear probing) only holds
+ * 32 bits indices into the vector, plus the probe distance and 16 bits of the
+ * hash of every key.
+ *
+ * Compared with jw::hash_map:
+ * 1. Iteration is a linear scan of the live values, whatever the load factor.
+ * 2. Growing the table rehashes the keys but never moves the values, a bucket
+ *    takes 8 bytes whatever the size of value_type.
+ * 3. No empty key is reserved, every key value can be inserted.
+ * 4. Erase moves the last value into the erased one (swap with last): the
+ *    values stay packed, the insertion order is kept except for the moved
+ *    value.
+ * 5. Lookups pay one more indirection, from the bucket to the value.
+ * 6. At most 2^32 - 1 elements, and at most 65535 keys with the same hash:
+ *    inserts past either limit throw std::length_error.
+ *
+ * Inserts invalidate iterators like std::vector::push_back, erase invalidates
+ * the iterators to the erased and to the last value.
+ *
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "hash_map.h"
+#include "power_of_two_growth_policy.h"
+
+namespace jw
+{
+
+namespace details
+{
+
+/**
+ * @brief Bucket of a dense_hash_map: where the value lives in the value
+ * vector, how far the bucket is from the home slot of its key and a hash
+ * fragment rejecting most mismatches without touching the value.
+ */
+struct dense_bucket
+{
+    bool empty() const noexcept
+    {
+        return m_dist == 0;
+    }
+
+    distance_type distance() const noexcept
+    {
+        return m_dist - 1;
+    }
+
+    void set_distance(distance_type dist) noexcept
+    {
+        assert(dist <= MAX_DISTANCE && "probe distance overflow");
+        m_dist = dist + 1;
+    }
+
+    static std::uint16_t fingerprint(std::size_t hash) noexcept
+    {
+        return static_cast<std::uint16_t>(hash >> 16);
+    }
+
+    std::uint32_t m_index       = 0;
+    std::uint16_t m_fingerprint = 0;
+    // Probe distance plus one, 0 marks an empty bucket
+    distance_type m_dist        = 0;
+};
+
+}
+
+template <typename Key,
+          typename T,
+          typename Hash         = std::hash<Key>,
+          typename KeyEqual     = std::equal_to<void>,
+          typename Allocator    = std::allocator<std::pair<Key, T>>,
+          typename GrowthPolicy = details::power_of_two_growth_policy<>>
+class dense_hash_map : private GrowthPolicy
+{
+    using GrowthPolicy::compute_index;
+    using GrowthPolicy::compute_closest_capacity;
+    using GrowthPolicy::compute_next_capacity;
+    using GrowthPolicy::minimum_capacity;
+
+public:
+    using key_type        = Key;
+    using mapped_type     = T;
+    using value_type      = std::pair<Key, T>;
+    using size_type       = std::size_t;
+    using hasher          = Hash;
+    using key_equal       = KeyEqual;
+    using allocator_type  = Allocator;
+    using reference       = value_type &;
+    using const_reference = const value_type &;
+    using values_type     = std::vector<value_type, allocator_type>;
+    using iterator        = typename values_type::iterator;
+    using const_iterator  = typename values_type::const_iterator;
+
+private:
+    using distance_type    = details::distance_type;
+    using bucket           = details::dense_bucket;
+    using bucket_allocator = typename std::allocator_traits<allocator_type>::template rebind_alloc<bucket>;
+    using buckets          = std::vector<bucket, bucket_allocator>;
+
+    static constexpr const size_type NPOS = std::numeric_limits<size_type>::max();
+
+    template <typename K>
+    static constexpr bool is_transparent_key = details::is_transparent<Hash>::value &&
+        details::is_transparent<KeyEqual>::value &&
+        !std::is_convertible<K, iterator>::value && !std::is_convertible<K, const_iterator>::value;
+
+    template <typename K>
+    using enable_if_transparent = std::enable_if_t<is_transparent_key<K>, int>;
+
+public:
+    dense_hash_map() : dense_hash_map(minimum_capacity())
+    { }
+
+    explicit dense_hash_map(size_type bucket_count, const allocator_type &alloc = allocator_type())
+        : m_values(alloc), m_buckets(compute_closest_capacity(bucket_count), bucket(), bucket_allocator(alloc))
+    { }
+
+    explicit dense_hash_map(const allocator_type &alloc)
+        : dense_hash_map(minimum_capacity(), alloc)
+    { }
+
+    allocator_type get_allocator() const noexcept
+    {
+        return m_values.get_allocator();
+    }
+
+    // Iterators, in insertion order
+    iterator begin() noexcept
+    {
+        return m_values.begin();
+    }
+
+    const_iterator begin() const noexcept
+    {
+        return m_values.begin();
+    }
+
+    const_iterator cbegin() const noexcept
+    {
+        return m_values.cbegin();
+    }
+
+    iterator end() noexcept
+    {
+        return m_values.end();
+    }
+
+    const_iterator end() const noexcept
+    {
+        return m_values.end();
+    }
+
+    const_iterator cend() const noexcept
+    {
+        return m_values.cend();
+    }
+
+    // The packed values, e.g. to hand them over to a snapshot at once
+    const values_type &values() const noexcept
+    {
+        return m_values;
+    }
+
+    // Capacity
+    bool empty() const noexcept
+    {
+        return m_values.empty();
+    }
+
+    size_type size() const noexcept
+    {
+        return m_values.size();
+    }
+
+    size_type max_size() const noexcept
+    {
+        return std::min<size_type>(m_values.max_size(), std::numeric_limits<std::uint32_t>::max());
+    }
+
+    // Modifiers
+    void clear() noexcept
+    {
+        m_values.clear();
+        std::fill(m_buckets.begin(), m_buckets.end(), bucket());
+        m_grow_on_next_insert = false;
+    }
+
+    std::pair<iterator, bool> insert(const value_type &value)
+    {
+        return emplace_impl(value.first, value.second);
+    }
+
+    std::pair<iterator, bool> insert(value_type &&value)
+    {
+        return emplace_impl(std::move(value.first), std::move(value.second));
+    }
+
+    template <typename... Args>
+    std::pair<iterator, bool> emplace(Args &&... args)
+    {
+        return emplace_impl(std::forward<Args>(args)...);
+    }
+
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const key_type &key, Args &&... args)
+    {
+        return emplace_impl(key, std::forward<Args>(args)...);
+    }
+
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(key_type &&key, Args &&... args)
+    {
+        return emplace_impl(std::move(key), std::forward<Args>(args)...);
+    }
+
+    template <typename K, typename... Args, enable_if_transparent<K> = 0>
+    std::pair<iterator, bool> try_emplace(K &&key, Args &&... args)
+    {
+        return emplace_impl(std::forward<K>(key), std::forward<Args>(args)...);
+    }
+
+    template <typename M>
+    std::pair<iterator, bool> insert_or_assign(const key_type &key, M &&obj)
+    {
+        return insert_or_assign_impl(key, std::forward<M>(obj));
+    }
+
+    template <typename M>
+    std::pair<iterator, bool> insert_or_assign(key_type &&key, M &&obj)
+    {
+        return insert_or_assign_impl(std::move(key), std::forward<M>(obj));
+    }
+
+    // Returns the iterator to the value moved into the erased one, end() if
+    // it was the last value
+    iterator erase(const_iterator it)
+    {
+        const size_type index = static_cast<size_type>(it - m_values.cbegin());
+        erase_bucket(find_bucket(it->first, hash_key(it->first)));
+        return m_values.begin() + index;
+    }
+
+    size_type erase(const key_type &key)
+    {
+        return erase_impl(key);
+    }
+
+    template <typename K, enable_if_transparent<K> = 0>
+    size_type erase(const K &x)
+    {
+        return erase_impl(x);
+    }
+
+    void swap(dense_hash_map &other) noexcept
+    {
+        std::swap(static_cast<GrowthPolicy&>(*this), static_cast<GrowthPolicy&>(other));
+        m_values.swap(other.m_values);
+        m_buckets.swap(other.m_buckets);
+        std::swap(m_max_load_factor, other.m_max_load_factor);
+        std::swap(m_grow_on_next_insert, other.m_grow_on_next_insert);
+    }
+
+    // Lookup
+    mapped_type &at(const key_type &key)
+    {
+        return at_impl(key);
+    }
+
+    template <typename K, enable_if_transparent<K> = 0>
+    mapped_type &at(const K &x)
+    {
+        return at_impl(x);
+    }
+
+    const mapped_type &at(const key_type &key) const
+    {
+        return const_cast<dense_hash_map*>(this)->at_impl(key);
+    }
+
+    template <typename K, enable_if_transparent<K> = 0>
+    const mapped_type &at(const K &x) const
+    {
+        return const_cast<dense_hash_map*>(this)->at_impl(x);
+    }
+
+    mapped_type &operator[](const key_type &key)
+    {
+        return emplace_impl(key).first->second;
+    }
+
+    mapped_type &operator[](key_type &&key)
+    {
+        return emplace_impl(std::move(key)).first->second;
+    }
+
+    size_type count(const key_type &key) const
+    {
+        return find_bucket(key, hash_key(key)) == NPOS ? 0 : 1;
+    }
+
+    template <typename K, enable_if_transparent<K> = 0>
+    size_type count(const K &x) const
+    {
+        return find_bucket(x, hash_key(x)) == NPOS ? 0 : 1;
+    }
+
+    iterator find(const key_type &key)
+    {
+        return find_impl(key);
+    }
+
+    template <typename K, enable_if_transparent<K> = 0>
+    iterator find(const K &x)
+    {
+        return find_impl(x);
+    }
+
+    const_iterator find(const key_type &key) const
+    {
+        return const_cast<dense_hash_map*>(this)->find_impl(key);
+    }
+
+    template <typename K, enable_if_transparent<K> = 0>
+    const_iterator find(const K &x) const
+    {
+        return const_cast<dense_hash_map*>(this)->find_impl(x);
+    }
+
+    // Bucket interface
+    size_type bucket_count() const noexcept
+    {
+        return m_buckets.size();
+    }
+
+    size_type max_bucket_count() const noexcept
+    {
+        return m_buckets.max_size();
+    }
+
+    // Hash policy
+    float load_factor() const noexcept
+    {
+        return static_cast<float>(size()) / bucket_count();
+    }
+
+    float max_load_factor() const noexcept
+    {
+        return m_max_load_factor;
+    }
+
+    void max_load_factor(float ml)
+    {
+        m_max_load_factor = std::clamp(ml, MINIMUM_MAX_LOAD_FACTOR, MAXIMUM_MAX_LOAD_FACTOR);
+
+        if (size() > bucket_count() * max_load_factor())
+        {
+            reserve(size());
+        }
+    }
+
+    // Only the buckets are rebuilt, the values don't move
+    void rehash(size_type count)
+    {
+        count = std::max(minimum_capacity(), count);
+        count = std::max(count, static_cast<size_type>(size() / max_load_factor()));
+
+        buckets other(compute_closest_capacity(count), bucket(), m_buckets.get_allocator());
+        m_buckets.swap(other);
+        const bool grow_on_next_insert = std::exchange(m_grow_on_next_insert, false);
+
+        // The values don't move, throwing keeps the old buckets
+        try
+        {
+            for (size_type index = 0; index < m_values.size(); ++index)
+            {
+                const std::size_t hash = hash_key(m_values[index].first);
+                const size_type   idx  = bucket_for_hash(hash);
+                check_displacement(idx, 0);
+                insert_bucket(idx, 0, hash, static_cast<std::uint32_t>(index));
+            }
+        }
+        catch (...)
+        {
+            m_buckets.swap(other);
+            m_grow_on_next_insert = grow_on_next_insert;
+            throw;
+        }
+    }
+
+    void reserve(size_type count)
+    {
+        m_values.reserve(count);
+        rehash(std::ceil(count / max_load_factor()));
+    }
+
+    // Observers
+    hasher hash_function() const
+    {
+        return hasher();
+    }
+
+    key_equal key_eq() const
+    {
+        return key_equal();
+    }
+
+private:
+    // Folded like jw::hash_map: the fingerprint reads bits 16 to 31, all 0
+    // under 65536 with the identity std::hash of integers
+    template <typename K>
+    std::size_t hash_key(const K &key) const noexcept(noexcept(hasher()(key)))
+    {
+        return details::table_hash<hasher>(hasher()(key));
+    }
+
+    size_type bucket_for_hash(std::size_t hash) const noexcept
+    {
+        return compute_index(hash, m_buckets.size());
+    }
+
+    size_type probe_next(size_type idx) const noexcept
+    {
+        return idx + 1 < m_buckets.size() ? idx + 1 : 0;
+    }
+
+    void check_for_rehash()
+    {
+        const bool long_probes = m_grow_on_next_insert &&
+            size() >= bucket_count() * details::MIN_LOAD_FACTOR_FOR_GROWTH;
+
+        if (long_probes || size() + 1 > bucket_count() * max_load_factor())
+        {
+            rehash(compute_next_capacity(bucket_count()));
+        }
+    }
+
+    // Bucket holding key, NPOS if key is not in the map
+    template <typename K>
+    size_type find_bucket(const K &key, std::size_t hash) const
+    {
+        const std::uint16_t fingerprint = bucket::fingerprint(hash);
+
+        size_type     idx  = bucket_for_hash(hash);
+        distance_type dist = 0;
+
+        for (; ; idx = probe_next(idx), ++dist)
+        {
+            const bucket &b = m_buckets[idx];
+            if (b.empty() || b.distance() < dist)
+            {
+                return NPOS;
+            }
+
+            if (b.m_fingerprint == fingerprint && key_equal()(m_values[b.m_index].first, key))
+            {
+                return idx;
+            }
+        }
+    }
+
+    template <typename K>
+    iterator find_impl(const K &key)
+    {
+        const size_type idx = find_bucket(key, hash_key(key));
+        return idx == NPOS ? end() : m_values.begin() + m_buckets[idx].m_index;
+    }
+
+    template <typename K>
+    mapped_type &at_impl(const K &key)
+    {
+        iterator it = find_impl(key);
+        if (it != end())
+        {
+            return it->second;
+        }
+
+        throw std::out_of_range("dense_hash_map::at");
+    }
+
+    // key is only forwarded, so moved from, on insertion
+    template <typename K, typename... Args>
+    std::pair<iterator, bool> emplace_impl(K &&key, Args &&... args)
+    {
+        if (size() >= max_size())
+        {
+            throw std::length_error("dense_hash_map is full");
+        }
+
+        check_for_rehash();
+
+        const std::size_t   hash        = hash_key(key);
+        const std::uint16_t fingerprint = bucket::fingerprint(hash);
+
+        size_type     idx  = bucket_for_hash(hash);
+        distance_type dist = 0;
+
+        for (; ; idx = probe_next(idx), ++dist)
+        {
+            const bucket &b = m_buckets[idx];
+            if (b.empty() || b.distance() < dist)
+            {
+                break;
+            }
+
+            if (b.m_fingerprint == fingerprint && key_equal()(m_values[b.m_index].first, key))
+            {
+                return {m_values.begin() + b.m_index, false};
+            }
+        }
+
+        // The value goes first, a throwing constructor leaves the buckets as they were
+        check_displacement(idx, dist);
+        const std::uint32_t index = static_cast<std::uint32_t>(m_values.size());
+        m_values.emplace_back(std::piecewise_construct,
+                              std::forward_as_tuple(std::forward<K>(key)),
+                              std::forward_as_tuple(std::forward<Args>(args)...));
+        insert_bucket(idx, dist, hash, index);
+
+        return {m_values.begin() + index, true};
+    }
+
+    template <typename K, typename M>
+    std::pair<iterator, bool> insert_or_assign_impl(K &&key, M &&obj)
+    {
+        auto res = emplace_impl(std::forward<K>(key), std::forward<M>(obj));
+        if (!res.second)
+        {
+            // obj was left untouched by the failed emplace
+            res.first->second = std::forward<M>(obj);
+        }
+        return res;
+    }
+
+    // Place index at idx (probe distance dist) and push the owners of the
+    // following buckets further until an empty bucket is found
+    void insert_bucket(size_type idx, distance_type dist, std::size_t hash, std::uint32_t index) noexcept
+    {
+        bucket carried;
+        carried.m_index       = index;
+        carried.m_fingerprint = bucket::fingerprint(hash);
+        carried.set_distance(dist);
+
+        for (; ; idx = probe_next(idx))
+        {
+            bucket &b = m_buckets[idx];
+            if (b.empty())
+            {
+                b = carried;
+                return;
+            }
+
+            if (b.distance() < carried.distance())
+            {
+                std::swap(b, carried);
+            }
+
+            carried.set_distance(carried.distance() + 1);
+            if (carried.distance() + 1 >= details::DIST_LIMIT)
+            {
+                m_grow_on_next_insert = true;
+            }
+        }
+    }
+
+    // Throws before anything moves if insert_bucket(idx, dist) would push a
+    // bucket past MAX_DISTANCE: it shifts every bucket from idx to the next
+    // empty one by one. Distances stay below DIST_LIMIT until
+    // m_grow_on_next_insert is set, only then is the run scanned
+    void check_displacement(size_type idx, distance_type dist) const
+    {
+        if (!m_grow_on_next_insert && dist < details::DIST_LIMIT)
+        {
+            return;
+        }
+
+        if (dist > details::MAX_DISTANCE)
+        {
+            throw std::length_error("dense_hash_map: too many keys with the same hash");
+        }
+        for (; !m_buckets[idx].empty(); idx = probe_next(idx))
+        {
+            if (m_buckets[idx].distance() >= details::MAX_DISTANCE)
+            {
+                throw std::length_error("dense_hash_map: too many keys with the same hash");
+            }
+        }
+    }
+
+    template <typename K>
+    size_type erase_impl(const K &key)
+    {
+        const size_type idx = find_bucket(key, hash_key(key));
+        if (idx == NPOS)
+        {
+            return 0;
+        }
+
+        erase_bucket(idx);
+        return 1;
+    }
+
+    // Backward shift erase of the bucket, then the last value fills the hole
+    // it left in the values
+    void erase_bucket(size_type idx)
+    {
+        const std::uint32_t index = m_buckets[idx].m_index;
+
+        size_type hole = idx;
+        for (size_type next = probe_next(hole); ; next = probe_next(next))
+        {
+            bucket &b = m_buckets[next];
+            if (b.empty() || b.distance() == 0)
+            {
+                m_buckets[hole] = bucket();
+                break;
+            }
+
+            m_buckets[hole] = b;
+            m_buckets[hole].set_distance(b.distance() - 1);
+            hole = next;
+        }
+
+        const std::uint32_t last = static_cast<std::uint32_t>(m_values.size() - 1);
+        if (index != last)
+        {
+            // Repoint the bucket of the last value before moving it
+            const std::size_t hash = hash_key(m_values[last].first);
+            size_type b = bucket_for_hash(hash);
+            while (m_buckets[b].empty() || m_buckets[b].m_index != last)
+            {
+                b = probe_next(b);
+            }
+            m_buckets[b].m_index = index;
+
+            m_values[index] = std::move(m_values[last]);
+        }
+        m_values.pop_back();
+    }
+
+private:
+    values_type m_values;
+    buckets     m_buckets;
+    float       m_max_load_factor     = DEFAULT_MAX_LOAD_FACTOR;
+    bool        m_grow_on_next_insert = false;
+};
+
+namespace pmr
+{
+
+template <typename Key,
+          typename T,
+          typename Hash         = std::hash<Key>,
+          typename KeyEqual     = std::equal_to<void>,
+          typename GrowthPolicy = details::power_of_two_growth_policy<>>
+using dense_hash_map = jw::dense_hash_map<Key, T, Hash, KeyEqual,
+                                          std::pmr::polymorphic_allocator<std::pair<Key, T>>,
+                                          GrowthPolicy>;
+
+}
+}
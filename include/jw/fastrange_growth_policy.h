@@ -0,0 +1,71 @@
+/**
+ * @file fastrange_growth_policy.h
+ * @author jian wu (jian.wu_93@foxmail.com)
+ * @brief Grow policy(any capacity, Lemire's fastrange)
+ * 
+ * The index is (hash * capacity) >> HashBits, a multiplication instead of a
+ * modulo, so the capacity can grow by any factor. The index comes from the
+ * high bits of the hash: use HashBits = 32 for 32-bit hashers such as CRC32,
+ * and an avalanching hasher for HashBits = 64 (identity hashes of small keys
+ * would all map to bucket 0).
+ * https://lemire.me/blog/2016/06/27/a-fast-alternative-to-the-modulo-reduction/
+ * 
+ * @version 0.1
+ * @date 2026-10-14
+ * 
+ * 
+ */
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace jw::details
+{
+
+/**
+ * @tparam GrowthNum, GrowthDen growth factor GrowthNum / GrowthDen, 3 / 2 by
+ * default
+ * @tparam HashBits number of significant (low) bits of the hash, 32 or 64
+ */
+template <std::size_t GrowthNum = 3, std::size_t GrowthDen = 2, unsigned HashBits = 64>
+struct fastrange_growth_policy
+{
+    static_assert(GrowthNum > GrowthDen && GrowthDen > 0, "growth factor must be > 1");
+    static_assert(HashBits == 32 || HashBits == 64, "HashBits must be 32 or 64");
+
+    static std::size_t compute_index(std::size_t hash, std::size_t capacity)
+    {
+        if constexpr (HashBits == 32)
+        {
+            assert(capacity <= std::numeric_limits<std::uint32_t>::max());
+            return static_cast<std::size_t>(
+                (static_cast<std::uint64_t>(static_cast<std::uint32_t>(hash)) * capacity) >> 32);
+        }
+        else
+        {
+            return static_cast<std::size_t>(
+                (static_cast<unsigned __int128>(hash) * capacity) >> 64);
+        }
+    }
+
+    static std::size_t compute_closest_capacity(std::size_t min_capacity)
+    {
+        return std::max(min_capacity, minimum_capacity());
+    }
+
+    static std::size_t compute_next_capacity(std::size_t capacity)
+    {
+        return capacity / GrowthDen * GrowthNum + GrowthNum;
+    }
+
+    static std::size_t minimum_capacity()
+    {
+        return 8u;
+    }
+};
+
+}
@@ -0,0 +1,818 @@
+/**
+ * @file flat_hash_map.h
+ * @author jian wu (jian.wu_93@foxmail.com)
+ * @brief Open addressing hash map with a separate control-byte array. Every
+ * slot owns one control byte holding either its state (empty / deleted) or the
+ * low 7 bits of the key hash. Probing loads 16 control bytes at once and
+ * compares them against the hash tag with SSE2, so the slot array (and the
+ * KeyEqual call) is only touched on a tag match.
+ *
+ * Compared with jw::hash_map:
+ * 1. No empty key is reserved, every key value can be inserted.
+ * 2. Slots are raw storage, value_type is only constructed when a slot is
+ *    occupied.
+ * 3. Erase leaves a tombstone unless the group of the slot was never full,
+ *    tombstones are reclaimed on the next rehash.
+ * 4. Maximum load factor is 87.5%.
+ * 5. Copy, move and swap follow the propagation traits of the allocator, as
+ *    jw::hash_map does: jw::pmr::flat_hash_map keeps its memory resource.
+ *
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "hash.h"
+#include "power_of_two_growth_policy.h"
+
+namespace jw
+{
+
+namespace details
+{
+
+using ctrl_t = std::int8_t;
+
+static constexpr const ctrl_t CTRL_EMPTY   = -128; // 0b10000000
+static constexpr const ctrl_t CTRL_DELETED = -2;   // 0b11111110
+
+static constexpr const std::size_t GROUP_WIDTH = 16;
+
+/**
+ * @brief A window of GROUP_WIDTH control bytes, every match returns a bit
+ * mask where bit i is set when control byte i matches.
+ */
+class ctrl_group
+{
+public:
+    explicit ctrl_group(const ctrl_t* pos) noexcept
+    {
+#ifdef __SSE2__
+        m_ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pos));
+#else
+        std::memcpy(m_ctrl, pos, GROUP_WIDTH);
+#endif
+    }
+
+    std::uint32_t match(ctrl_t h2) const noexcept
+    {
+#ifdef __SSE2__
+        return static_cast<std::uint32_t>(
+            _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), m_ctrl)));
+#else
+        std::uint32_t mask = 0;
+        for (std::size_t i = 0; i < GROUP_WIDTH; ++i)
+        {
+            mask |= static_cast<std::uint32_t>(m_ctrl[i] == h2) << i;
+        }
+        return mask;
+#endif
+    }
+
+    std::uint32_t match_empty() const noexcept
+    {
+        return match(CTRL_EMPTY);
+    }
+
+    // Empty and deleted are the only control bytes with a value < -1
+    std::uint32_t match_empty_or_deleted() const noexcept
+    {
+#ifdef __SSE2__
+        return static_cast<std::uint32_t>(
+            _mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(-1), m_ctrl)));
+#else
+        std::uint32_t mask = 0;
+        for (std::size_t i = 0; i < GROUP_WIDTH; ++i)
+        {
+            mask |= static_cast<std::uint32_t>(m_ctrl[i] < -1) << i;
+        }
+        return mask;
+#endif
+    }
+
+private:
+#ifdef __SSE2__
+    __m128i m_ctrl;
+#else
+    ctrl_t m_ctrl[GROUP_WIDTH];
+#endif
+};
+
+inline std::size_t lowest_bit(std::uint32_t mask) noexcept
+{
+    return static_cast<std::size_t>(__builtin_ctz(mask));
+}
+
+}
+
+static constexpr const float FLAT_MAX_LOAD_FACTOR = 0.875f;
+
+template <typename Key,
+          typename T,
+          typename Hash      = std::hash<Key>,
+          typename KeyEqual  = std::equal_to<void>,
+          typename Allocator = std::allocator<std::pair<Key, T>>>
+class flat_hash_map
+{
+public:
+    using key_type        = Key;
+    using mapped_type     = T;
+    using value_type      = std::pair<Key, T>;
+    using size_type       = std::size_t;
+    using hasher          = Hash;
+    using key_equal       = KeyEqual;
+    using allocator_type  = Allocator;
+    using reference       = value_type &;
+    using const_reference = const value_type &;
+
+private:
+    using alloc_traits    = std::allocator_traits<allocator_type>;
+    using ctrl_allocator  = typename alloc_traits::template rebind_alloc<details::ctrl_t>;
+    using ctrl_bytes      = std::vector<details::ctrl_t, ctrl_allocator>;
+    using growth_policy   = details::power_of_two_growth_policy<>;
+
+public:
+    template <typename ContT, typename IterVal>
+    struct flat_hash_map_iterator
+    {
+        using difference_type   = std::ptrdiff_t;
+        using value_type        = IterVal;
+        using pointer           = value_type*;
+        using reference         = value_type&;
+        using iterator_category = std::forward_iterator_tag;
+
+        bool operator==(const flat_hash_map_iterator &other) const
+        {
+            return other.hm_ == hm_ && other.idx_ == idx_;
+        }
+
+        bool operator!=(const flat_hash_map_iterator &other) const
+        {
+            return !(other == *this);
+        }
+
+        flat_hash_map_iterator &operator++()
+        {
+            ++idx_;
+            advance_past_empty();
+            return *this;
+        }
+
+        reference operator*() const
+        {
+            return hm_->m_slots[idx_];
+        }
+
+        pointer operator->() const
+        {
+            return &hm_->m_slots[idx_];
+        }
+
+    private:
+        explicit flat_hash_map_iterator(ContT* hm) : hm_(hm)
+        {
+            advance_past_empty();
+        }
+
+        explicit flat_hash_map_iterator(ContT* hm, size_type idx) : hm_(hm), idx_(idx) { }
+
+        void advance_past_empty()
+        {
+            while (idx_ < hm_->m_capacity && hm_->m_ctrl[idx_] < 0)
+            {
+                ++idx_;
+            }
+        }
+
+        ContT* hm_ = nullptr;
+        typename ContT::size_type idx_ = 0;
+        friend ContT;
+    };
+
+    using iterator       = flat_hash_map_iterator<flat_hash_map, value_type>;
+    using const_iterator = flat_hash_map_iterator<const flat_hash_map, const value_type>;
+
+private:
+    // Heterogeneous lookup needs both Hash and KeyEqual transparent, other
+    // keys are converted to key_type first
+    template <typename K>
+    static constexpr bool is_transparent_key = details::is_transparent<Hash>::value &&
+        details::is_transparent<KeyEqual>::value &&
+        !std::is_convertible<K, iterator>::value && !std::is_convertible<K, const_iterator>::value;
+
+    template <typename K>
+    using enable_if_transparent = std::enable_if_t<is_transparent_key<K>, int>;
+
+public:
+    flat_hash_map() : flat_hash_map(details::GROUP_WIDTH)
+    { }
+
+    explicit flat_hash_map(size_type bucket_count,
+                           const allocator_type &alloc = allocator_type())
+        : m_alloc(alloc), m_ctrl(ctrl_allocator(alloc))
+    {
+        allocate_slots(normalize_capacity(bucket_count));
+    }
+
+    explicit flat_hash_map(const allocator_type &alloc)
+        : flat_hash_map(details::GROUP_WIDTH, alloc)
+    { }
+
+    flat_hash_map(const flat_hash_map &other)
+        : flat_hash_map(other, alloc_traits::select_on_container_copy_construction(other.m_alloc))
+    { }
+
+    flat_hash_map(const flat_hash_map &other, const allocator_type &alloc)
+        : flat_hash_map(other.m_capacity, alloc)
+    {
+        for (auto it = other.cbegin(); it != other.cend(); ++it)
+        {
+            insert(*it);
+        }
+    }
+
+    // other is left without slots: lookups on it find nothing, the next
+    // insert allocates
+    flat_hash_map(flat_hash_map &&other) noexcept
+        : m_alloc(std::move(other.m_alloc)),
+          m_ctrl(std::move(other.m_ctrl)),
+          m_slots(std::exchange(other.m_slots, nullptr)),
+          m_capacity(std::exchange(other.m_capacity, 0)),
+          m_size(std::exchange(other.m_size, 0)),
+          m_growth_left(std::exchange(other.m_growth_left, 0))
+    { }
+
+    flat_hash_map &operator=(const flat_hash_map &other)
+    {
+        if (this != &other)
+        {
+            if constexpr (alloc_traits::propagate_on_container_copy_assignment::value)
+            {
+                flat_hash_map copy(other, other.m_alloc);
+                destroy_slots();
+                m_alloc = other.m_alloc;
+                move_storage(copy);
+            }
+            else
+            {
+                flat_hash_map copy(other, m_alloc);
+                swap_storage(copy);
+            }
+        }
+        return *this;
+    }
+
+    flat_hash_map &operator=(flat_hash_map &&other) noexcept(
+        alloc_traits::propagate_on_container_move_assignment::value || alloc_traits::is_always_equal::value)
+    {
+        if (this == &other)
+        {
+            return *this;
+        }
+
+        if constexpr (alloc_traits::propagate_on_container_move_assignment::value)
+        {
+            destroy_slots();
+            m_alloc = std::move(other.m_alloc);
+            move_storage(other);
+        }
+        else if (m_alloc == other.m_alloc)
+        {
+            swap_storage(other);
+        }
+        else
+        {
+            // Slots can't change hands, move the elements one by one
+            flat_hash_map moved(other.m_capacity, m_alloc);
+            for (auto &value : other)
+            {
+                moved.insert(std::move(value));
+            }
+            swap_storage(moved);
+        }
+        return *this;
+    }
+
+    ~flat_hash_map()
+    {
+        destroy_slots();
+    }
+
+    allocator_type get_allocator() const noexcept
+    {
+        return m_alloc;
+    }
+
+    // Iterators
+    iterator begin() noexcept
+    {
+        return iterator(this);
+    }
+
+    const_iterator begin() const noexcept
+    {
+        return const_iterator(this);
+    }
+
+    const_iterator cbegin() const noexcept
+    {
+        return const_iterator(this);
+    }
+
+    iterator end() noexcept
+    {
+        return iterator(this, m_capacity);
+    }
+
+    const_iterator end() const noexcept
+    {
+        return const_iterator(this, m_capacity);
+    }
+
+    const_iterator cend() const noexcept
+    {
+        return const_iterator(this, m_capacity);
+    }
+
+    // Capacity
+    bool empty() const noexcept
+    {
+        return size() == 0;
+    }
+
+    size_type size() const noexcept
+    {
+        return m_size;
+    }
+
+    size_type max_size() const noexcept
+    {
+        return alloc_traits::max_size(m_alloc);
+    }
+
+    // Modifiers
+    void clear() noexcept
+    {
+        for (size_type idx = 0; idx < m_capacity; ++idx)
+        {
+            if (m_ctrl[idx] >= 0)
+            {
+                alloc_traits::destroy(m_alloc, m_slots + idx);
+            }
+        }
+        std::fill(m_ctrl.begin(), m_ctrl.end(), details::CTRL_EMPTY);
+        m_size        = 0;
+        m_growth_left = capacity_to_growth(m_capacity);
+    }
+
+    std::pair<iterator, bool> insert(const value_type &value)
+    {
+        return emplace_impl(value.first, value.second);
+    }
+
+    std::pair<iterator, bool> insert(value_type&& value)
+    {
+        return emplace_impl(value.first, std::move(value.second));
+    }
+
+    template <typename... Args>
+    std::pair<iterator, bool> emplace(Args &&... args)
+    {
+        return emplace_impl(std::forward<Args>(args)...);
+    }
+
+    void erase(iterator it)
+    {
+        erase_impl(it.idx_);
+    }
+
+    size_type erase(const key_type &key)
+    {
+        return erase_key_impl(key);
+    }
+
+    template <typename K, enable_if_transparent<K> = 0>
+    size_type erase(const K& x)
+    {
+        return erase_key_impl(x);
+    }
+
+    void swap(flat_hash_map &other) noexcept
+    {
+        if constexpr (alloc_traits::propagate_on_container_swap::value)
+        {
+            using std::swap;
+            swap(m_alloc, other.m_alloc);
+        }
+        swap_storage(other);
+    }
+
+    // Lookup
+    mapped_type &at(const key_type &key)
+    {
+        return at_impl(key);
+    }
+
+    template <typename K, enable_if_transparent<K> = 0>
+    mapped_type &at(const K &x)
+    {
+        return at_impl(x);
+    }
+
+    const mapped_type &at(const key_type &key) const
+    {
+        return at_impl(key);
+    }
+
+    template <typename K, enable_if_transparent<K> = 0>
+    const mapped_type &at(const K &x) const
+    {
+        return at_impl(x);
+    }
+
+    mapped_type &operator[](const key_type &key)
+    {
+        return emplace_impl(key).first->second;
+    }
+
+    size_type count(const key_type &key) const
+    {
+        return find_impl(key) == m_capacity ? 0 : 1;
+    }
+
+    template <typename K, enable_if_transparent<K> = 0>
+    size_type count(const K &x) const
+    {
+        return find_impl(x) == m_capacity ? 0 : 1;
+    }
+
+    iterator find(const key_type &key)
+    {
+        return iterator(this, find_impl(key));
+    }
+
+    template <typename K, enable_if_transparent<K> = 0>
+    iterator find(const K &x)
+    {
+        return iterator(this, find_impl(x));
+    }
+
+    const_iterator find(const key_type &key) const
+    {
+        return const_iterator(this, find_impl(key));
+    }
+
+    template <typename K, enable_if_transparent<K> = 0>
+    const_iterator find(const K &x) const
+    {
+        return const_iterator(this, find_impl(x));
+    }
+
+    // Bucket interface
+    size_type bucket_count() const noexcept
+    {
+        return m_capacity;
+    }
+
+    size_type max_bucket_count() const noexcept
+    {
+        return max_size();
+    }
+
+    // Hash policy
+    float max_load_factor() const noexcept
+    {
+        return FLAT_MAX_LOAD_FACTOR;
+    }
+
+    void rehash(size_type count)
+    {
+        count = std::max(count, static_cast<size_type>(std::ceil(size() / max_load_factor())));
+        resize(normalize_capacity(count));
+    }
+
+    void reserve(std::size_t count)
+    {
+        rehash(std::ceil(count / max_load_factor()));
+    }
+
+    // Observers
+    hasher hash_function() const
+    {
+        return hasher();
+    }
+
+    key_equal key_eq() const
+    {
+        return key_equal();
+    }
+
+private:
+    template <typename K, typename... Args>
+    std::pair<iterator, bool> emplace_impl(const K& key, Args&& ...args)
+    {
+        const std::size_t hash = hash_key(key);
+
+        if (m_capacity == 0)
+        {
+            resize(normalize_capacity(0));
+        }
+
+        size_type idx = find_impl(key, hash);
+        if (idx != m_capacity)
+        {
+            return {iterator(this, idx), false};
+        }
+
+        idx = find_first_non_full(hash);
+        if (m_growth_left == 0 && m_ctrl[idx] != details::CTRL_DELETED)
+        {
+            check_for_rehash();
+            idx = find_first_non_full(hash);
+        }
+
+        alloc_traits::construct(m_alloc, m_slots + idx,
+                                std::piecewise_construct,
+                                std::forward_as_tuple(key),
+                                std::forward_as_tuple(std::forward<Args>(args)...));
+
+        m_growth_left -= m_ctrl[idx] == details::CTRL_EMPTY;
+        m_ctrl[idx] = h2(hash);
+        ++m_size;
+
+        return {iterator(this, idx), true};
+    }
+
+    void erase_impl(size_type idx)
+    {
+        alloc_traits::destroy(m_alloc, m_slots + idx);
+        --m_size;
+
+        // A group which still has an empty slot has never been full, so no
+        // probe sequence went past it and the slot can become empty again.
+        const size_type group = idx & ~(details::GROUP_WIDTH - 1);
+        if (details::ctrl_group(&m_ctrl[group]).match_empty())
+        {
+            m_ctrl[idx] = details::CTRL_EMPTY;
+            ++m_growth_left;
+        }
+        else
+        {
+            m_ctrl[idx] = details::CTRL_DELETED;
+        }
+    }
+
+    template <typename K>
+    size_type erase_key_impl(const K &key)
+    {
+        size_type idx = find_impl(key);
+        if (idx != m_capacity)
+        {
+            erase_impl(idx);
+            return 1;
+        }
+
+        return 0;
+    }
+
+    template <typename K>
+    mapped_type &at_impl(const K &key)
+    {
+        size_type idx = find_impl(key);
+        if (idx != m_capacity)
+        {
+            return m_slots[idx].second;
+        }
+        throw std::out_of_range("flat_hash_map::at");
+    }
+
+    template <typename K>
+    const mapped_type &at_impl(const K &key) const
+    {
+        return const_cast<flat_hash_map*>(this)->at_impl(key);
+    }
+
+    template <typename K>
+    size_type find_impl(const K &key) const
+    {
+        return find_impl(key, hash_key(key));
+    }
+
+    template <typename K>
+    size_type find_impl(const K &key, std::size_t hash) const
+    {
+        if (m_capacity == 0)
+        {
+            return m_capacity;
+        }
+
+        const details::ctrl_t tag = h2(hash);
+        const size_type mask = group_mask();
+
+        size_type group = h1(hash) & mask;
+        for (size_type step = 1; ; group = (group + step++) & mask)
+        {
+            const size_type base = group * details::GROUP_WIDTH;
+            details::ctrl_group g(&m_ctrl[base]);
+
+            for (std::uint32_t bits = g.match(tag); bits != 0; bits &= bits - 1)
+            {
+                const size_type idx = base + details::lowest_bit(bits);
+                if (key_equal()(m_slots[idx].first, key))
+                {
+                    return idx;
+                }
+            }
+
+            if (g.match_empty())
+            {
+                return m_capacity;
+            }
+        }
+    }
+
+    size_type find_first_non_full(std::size_t hash) const noexcept
+    {
+        const size_type mask = group_mask();
+
+        size_type group = h1(hash) & mask;
+        for (size_type step = 1; ; group = (group + step++) & mask)
+        {
+            const size_type base = group * details::GROUP_WIDTH;
+            std::uint32_t bits = details::ctrl_group(&m_ctrl[base]).match_empty_or_deleted();
+            if (bits != 0)
+            {
+                return base + details::lowest_bit(bits);
+            }
+        }
+    }
+
+    void check_for_rehash()
+    {
+        // Tombstones take up at least half of the reserved growth, reclaim
+        // them in place instead of doubling the table.
+        if (size() + 1 <= capacity_to_growth(m_capacity) / 2)
+        {
+            resize(m_capacity);
+        }
+        else
+        {
+            resize(m_capacity << 1);
+        }
+    }
+
+    void resize(size_type new_capacity)
+    {
+        ctrl_bytes  old_ctrl     = std::move(m_ctrl);
+        value_type* old_slots    = m_slots;
+        size_type   old_capacity = m_capacity;
+
+        m_ctrl = ctrl_bytes(ctrl_allocator(m_alloc));
+        allocate_slots(new_capacity);
+
+        for (size_type idx = 0; idx < old_capacity; ++idx)
+        {
+            if (old_ctrl[idx] < 0)
+            {
+                continue;
+            }
+
+            const std::size_t hash = hash_key(old_slots[idx].first);
+            const size_type   dst  = find_first_non_full(hash);
+
+            alloc_traits::construct(m_alloc, m_slots + dst, std::move(old_slots[idx]));
+            alloc_traits::destroy(m_alloc, old_slots + idx);
+            m_ctrl[dst] = h2(hash);
+        }
+
+        m_growth_left -= m_size;
+        alloc_traits::deallocate(m_alloc, old_slots, old_capacity);
+    }
+
+    void allocate_slots(size_type capacity)
+    {
+        m_capacity    = capacity;
+        m_slots       = alloc_traits::allocate(m_alloc, capacity);
+        m_growth_left = capacity_to_growth(capacity);
+        m_ctrl.assign(capacity, details::CTRL_EMPTY);
+    }
+
+    void destroy_slots() noexcept
+    {
+        if (m_slots == nullptr)
+        {
+            return;
+        }
+
+        for (size_type idx = 0; idx < m_capacity; ++idx)
+        {
+            if (m_ctrl[idx] >= 0)
+            {
+                alloc_traits::destroy(m_alloc, m_slots + idx);
+            }
+        }
+        alloc_traits::deallocate(m_alloc, m_slots, m_capacity);
+        m_ctrl.clear();
+        m_slots       = nullptr;
+        m_capacity    = 0;
+        m_size        = 0;
+        m_growth_left = 0;
+    }
+
+    // Takes the slots of other, this holds none. The control bytes are
+    // move assigned, their allocator propagates as allocator_type does
+    void move_storage(flat_hash_map &other) noexcept
+    {
+        m_ctrl = std::move(other.m_ctrl);
+        other.m_ctrl.clear();
+        m_slots       = std::exchange(other.m_slots, nullptr);
+        m_capacity    = std::exchange(other.m_capacity, 0);
+        m_size        = std::exchange(other.m_size, 0);
+        m_growth_left = std::exchange(other.m_growth_left, 0);
+    }
+
+    // Both tables use equal allocators
+    void swap_storage(flat_hash_map &other) noexcept
+    {
+        m_ctrl.swap(other.m_ctrl);
+        std::swap(m_slots, other.m_slots);
+        std::swap(m_capacity, other.m_capacity);
+        std::swap(m_size, other.m_size);
+        std::swap(m_growth_left, other.m_growth_left);
+    }
+
+    static size_type normalize_capacity(size_type count) noexcept
+    {
+        count = std::max(count, details::GROUP_WIDTH);
+        return growth_policy::compute_closest_capacity(count);
+    }
+
+    static size_type capacity_to_growth(size_type capacity) noexcept
+    {
+        return capacity - capacity / 8;
+    }
+
+    // H1 and H2 are cut from the folded hash: the identity std::hash of
+    // integers would give consecutive keys the same group and tag
+    template <typename K>
+    static std::size_t hash_key(const K &key)
+    {
+        return details::table_hash<hasher>(hasher()(key));
+    }
+
+    static size_type h1(std::size_t hash) noexcept
+    {
+        return hash >> 7;
+    }
+
+    static details::ctrl_t h2(std::size_t hash) noexcept
+    {
+        return static_cast<details::ctrl_t>(hash & 0x7f);
+    }
+
+    size_type group_mask() const noexcept
+    {
+        return m_capacity / details::GROUP_WIDTH - 1;
+    }
+
+private:
+    allocator_type m_alloc;
+    ctrl_bytes     m_ctrl;
+    value_type*    m_slots       = nullptr;
+    size_type      m_capacity    = 0;
+    size_type      m_size        = 0;
+    size_type      m_growth_left = 0;
+};
+
+namespace pmr
+{
+
+template <typename Key,
+          typename T,
+          typename Hash     = std::hash<Key>,
+          typename KeyEqual = std::equal_to<void>>
+using flat_hash_map = jw::flat_hash_map<Key, T, Hash, KeyEqual,
+                                        std::pmr::polymorphic_allocator<std::pair<Key, T>>>;
+
+}
+}
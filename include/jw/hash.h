@@ -0,0 +1,252 @@
+/**
+ * @file hash.h
+ * @author jian wu (jian.wu_93@foxmail.com)
+ * @brief Hashers whose every output bit depends on every input bit, so the
+ * tables may index from any part of the hash.
+ *
+ * - jw::hash<integer, enum or pointer>: one 64x64->128 bits multiply,
+ *   folded (high half xor low half)
+ * - jw::hash<std::string> and jw::hash<std::string_view>: jw::hash_bytes, a
+ *   wyhash style hash reading 16 bytes per multiply, transparent
+ * - jw::crc32_hash: strings hashed 8 bytes per crc32 instruction on two
+ *   lanes, when SSE4.2 is enabled (JW_HAVE_CRC32)
+ * - other types fall back to std::hash
+ *
+ * is_avalanching<Hash> is true for hashers declaring
+ * `using is_avalanching = void;` (the same tag as ankerl::unordered_dense).
+ * jw::hash_map folds the output of other hashers with one multiply before
+ * using it: std::hash of integers is the identity on libstdc++, and a crc32
+ * only fills 32 bits, either would pile up keys in a few clusters of a
+ * power of two table.
+ *
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ *
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#define JW_HAVE_CRC32 1
+#endif
+
+namespace jw
+{
+
+template <typename Hash, typename = void>
+struct is_avalanching : std::false_type
+{ };
+
+template <typename Hash>
+struct is_avalanching<Hash, std::void_t<typename Hash::is_avalanching>> : std::true_type
+{ };
+
+namespace details
+{
+
+// Hashers and key comparators declaring is_transparent accept any key type
+// they can be called with, not only key_type
+template <typename T, typename = void>
+struct is_transparent : std::false_type
+{ };
+
+template <typename T>
+struct is_transparent<T, std::void_t<typename T::is_transparent>> : std::true_type
+{ };
+
+static constexpr const std::uint64_t HASH_P0 = 0xA0761D6478BD642Full;
+static constexpr const std::uint64_t HASH_P1 = 0xE7037ED1A0B428DBull;
+static constexpr const std::uint64_t HASH_P2 = 0x8EBC6AF09C88C6E3ull;
+static constexpr const std::uint64_t HASH_GOLDEN = 0x9E3779B97F4A7C15ull;
+
+// 64x64->128 bits multiply folded back to 64 bits
+inline std::uint64_t mum(std::uint64_t a, std::uint64_t b) noexcept
+{
+#if defined(__SIZEOF_INT128__)
+    const unsigned __int128 r = static_cast<unsigned __int128>(a) * b;
+    return static_cast<std::uint64_t>(r) ^ static_cast<std::uint64_t>(r >> 64);
+#else
+    const std::uint64_t ha = a >> 32, la = static_cast<std::uint32_t>(a);
+    const std::uint64_t hb = b >> 32, lb = static_cast<std::uint32_t>(b);
+    const std::uint64_t hh = ha * hb, hl = ha * lb, lh = la * hb, ll = la * lb;
+    const std::uint64_t mid = (ll >> 32) + static_cast<std::uint32_t>(hl) + static_cast<std::uint32_t>(lh);
+    const std::uint64_t lo  = (mid << 32) | static_cast<std::uint32_t>(ll);
+    const std::uint64_t hi  = hh + (hl >> 32) + (lh >> 32) + (mid >> 32);
+    return lo ^ hi;
+#endif
+}
+
+inline std::uint64_t read64(const unsigned char* p) noexcept
+{
+    std::uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+inline std::uint64_t read32(const unsigned char* p) noexcept
+{
+    std::uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// Hash the tables index from: the hasher output itself when it avalanches,
+// folded with one multiply otherwise
+template <typename Hash>
+inline std::size_t table_hash(std::size_t hash) noexcept
+{
+    if constexpr (is_avalanching<Hash>::value)
+    {
+        return hash;
+    }
+    else
+    {
+        return static_cast<std::size_t>(mum(hash, HASH_GOLDEN));
+    }
+}
+
+}
+
+// wyhash style: 16 bytes per multiply, the tail read with overlapping loads
+inline std::uint64_t hash_bytes(const void* data, std::size_t len, std::uint64_t seed = 0) noexcept
+{
+    using namespace details;
+
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    seed ^= mum(seed ^ HASH_P0, HASH_P1);
+
+    std::uint64_t a = 0;
+    std::uint64_t b = 0;
+    if (len <= 16)
+    {
+        if (len >= 4)
+        {
+            const std::size_t mid = (len >> 3) << 2;
+            a = (read32(p) << 32) | read32(p + mid);
+            b = (read32(p + len - 4) << 32) | read32(p + len - 4 - mid);
+        }
+        else if (len > 0)
+        {
+            a = (std::uint64_t{p[0]} << 16) | (std::uint64_t{p[len >> 1]} << 8) | p[len - 1];
+        }
+    }
+    else
+    {
+        std::size_t i = len;
+        if (i > 48)
+        {
+            std::uint64_t see1 = seed;
+            std::uint64_t see2 = seed;
+            do
+            {
+                seed = mum(read64(p) ^ HASH_P1, read64(p + 8) ^ seed);
+                see1 = mum(read64(p + 16) ^ HASH_P2, read64(p + 24) ^ see1);
+                see2 = mum(read64(p + 32) ^ HASH_P0, read64(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+        while (i > 16)
+        {
+            seed = mum(read64(p) ^ HASH_P1, read64(p + 8) ^ seed);
+            p += 16;
+            i -= 16;
+        }
+        a = read64(p + i - 16);
+        b = read64(p + i - 8);
+    }
+
+    return mum(HASH_P1 ^ len, mum(a ^ HASH_P1, b ^ seed));
+}
+
+template <typename T, typename = void>
+struct hash : std::hash<T>
+{ };
+
+template <typename T>
+struct hash<T, std::enable_if_t<std::is_integral<T>::value || std::is_enum<T>::value || std::is_pointer<T>::value>>
+{
+    using is_avalanching = void;
+
+    std::size_t operator()(T key) const noexcept
+    {
+        std::uint64_t bits;
+        if constexpr (std::is_pointer<T>::value)
+        {
+            bits = reinterpret_cast<std::uintptr_t>(key);
+        }
+        else
+        {
+            bits = static_cast<std::uint64_t>(key);
+        }
+        return static_cast<std::size_t>(details::mum(bits, details::HASH_GOLDEN));
+    }
+};
+
+template <>
+struct hash<std::string_view>
+{
+    using is_avalanching = void;
+    using is_transparent = void;
+
+    std::size_t operator()(std::string_view str) const noexcept
+    {
+        return static_cast<std::size_t>(hash_bytes(str.data(), str.size()));
+    }
+};
+
+template <>
+struct hash<std::string> : hash<std::string_view>
+{ };
+
+#ifdef JW_HAVE_CRC32
+/**
+ * @brief String hasher on the crc32 instruction: two lanes of 8 bytes per
+ * crc32, folded with their length by one multiply so the result avalanches.
+ */
+struct crc32_hash
+{
+    using is_avalanching = void;
+    using is_transparent = void;
+
+    std::size_t operator()(std::string_view str) const noexcept
+    {
+        const unsigned char* p   = reinterpret_cast<const unsigned char*>(str.data());
+        std::size_t          len = str.size();
+
+        std::uint64_t a = 0;
+        std::uint64_t b = details::HASH_P0;
+        for (; len >= 16; p += 16, len -= 16)
+        {
+            a = _mm_crc32_u64(a, details::read64(p));
+            b = _mm_crc32_u64(b, details::read64(p + 8));
+        }
+        if (len >= 8)
+        {
+            a = _mm_crc32_u64(a, details::read64(p));
+            p += 8;
+            len -= 8;
+        }
+        if (len > 0)
+        {
+            std::uint64_t tail = 0;
+            std::memcpy(&tail, p, len);
+            b = _mm_crc32_u64(b, tail);
+        }
+
+        return static_cast<std::size_t>(details::mum(a ^ (b << 32) ^ str.size(), details::HASH_GOLDEN));
+    }
+};
+#endif
+
+}
@@ -2,7 +2,7 @@
  * @file hash_map.h
  * @author jian wu (jian.wu_93@foxmail.com)
  * @brief A simple implementation of Hash map. Using open addressing with
- * linear probing to solve hash collision
+ * linear probing and Robin Hood displacement to solve hash collision
  * 
  * Advantages:
  * 1. Linear probing ensures cache efficency. High performance in lookup
@@ -16,11 +16,61 @@
  *    most of the table.
  *    https://en.wikipedia.org/wiki/Lazy_deletion
  * 
- * 3. Doesn't use the allocator unless load factor grows beyond 50%.
+ * 3. Robin Hood insertion keeps every key close to its ideal slot, so the
+ *    table stays fast up to 85%-90% load. The probe distance of every bucket
+ *    is kept in a separate array, lookups stop as soon as they meet a bucket
+ *    closer to its ideal slot than the key would be, and erase shifts the
+ *    following buckets back without rehashing their keys.
+ *    https://en.wikipedia.org/wiki/Hash_table#Robin_Hood_hashing
+ * 
+ * 4. Doesn't use the allocator unless load factor grows beyond
+ *    max_load_factor() (80% by default). Buckets are raw storage, a value is
+ *    only constructed when its bucket gets occupied, and the metadata of a
+ *    table allocated with std::allocator comes zeroed from calloc: the pages
+ *    of a big reserve() are only touched once buckets get used.
+ * 
+ * 5. StoreHash keeps 32 bits of the hash in the bucket metadata: probing
+ *    rejects a bucket on hash mismatch before calling KeyEqual and rehash
+ *    reuses the stored hash when the growth policy indexes from the low bits.
+ *    Useful for keys which are expensive to hash or compare, free otherwise.
+ * 
+ * 6. Memory is reclaimed by shrink_to_fit() and clear_and_release(), or on
+ *    erase once the load factor falls below min_load_factor() (0 by default,
+ *    never shrinks). A shrink leaves the table at most half of
+ *    max_load_factor() full, so erases and inserts around the threshold
+ *    don't make the table shrink and grow back in turns.
+ * 
+ * 7. clear() is a memset of the bucket metadata for trivially destructible
+ *    values. With EpochClear it is O(1): it raises the epoch base of the
+ *    table, buckets written under an older epoch read as empty. The metadata
+ *    is only wiped every 65535 clears.
+ * 
+ * 8. stats() reports probe displacements and clusters of the table. Defining
+ *    JW_HASH_MAP_STATS (the same way in every translation unit) also counts
+ *    lookup probe lengths, rehashes and erase shifts, without it the
+ *    counters don't exist and cost nothing.
+ * 
+ * 9. hash_map(unique_keys, first, last, threads) builds the table from a
+ *    range without duplicate keys in one pass: sized once, no rehash and no
+ *    duplicate check. With several threads the keys are hashed in parallel
+ *    and each thread fills its own slice of the buckets.
+ * 
+ * 10. Empty buckets are marked in the bucket metadata, the empty key is only
+ *     checked against in debug builds. Integral and enum keys reserve none
+ *     at all, 0 is a key like any other.
+ * 
+ * 11. Hashers not tagged is_avalanching (jw/hash.h) get their output folded
+ *     by one multiply before indexing, identity hashes of integers and 32
+ *     bits crc32 don't cluster the table. jw::hash is tagged and used as is.
  * 
  * Disadvantages:
- * 1. Maximum load factor is up to 50%, memory inefficient.
- * 2. Memory is not reclaimed on erase.
+ * 1. Erasing by key can shrink the table, and so invalidate every iterator,
+ *    when min_load_factor() is set.
+ * 
+ * 2. Probe distances are 16 bits: an insert which would put a key 65535
+ *    buckets or more from its ideal slot throws std::length_error, leaving
+ *    the table unchanged. Only a hasher giving more than 65535 keys the same
+ *    hash gets there, growing doesn't split such a run.
  * 
  * @version 0.1
  * @date 2024-02-16
@@ -29,237 +79,85 @@
  */
 #pragma once
 
-#include <algorithm>
-#include <cassert>
-#include <cmath>
-#include <cstddef>
-#include <cstdint>
-#include <limits>
+#include <functional>
+#include <memory>
+#include <memory_resource>
 #include <stdexcept>
-#include <vector>
+#include <utility>
 
-#include "power_of_two_growth_policy.h"
+#include "robin_hood_table.h"
 
 namespace jw 
 {
 
-static constexpr const float DEFAULT_MAX_LOAD_FACTOR = 0.500f;
-
 template <typename Key, 
           typename T, 
           typename Hash         = std::hash<Key>,
           typename KeyEqual     = std::equal_to<void>,
           typename Allocator    = std::allocator<std::pair<Key, T>>,
-          typename GrowthPolicy = details::power_of_two_growth_policy>
-class hash_map : private GrowthPolicy
+          typename GrowthPolicy = details::power_of_two_growth_policy<>,
+          bool StoreHash        = false,
+          bool EpochClear       = false>
+class hash_map 
+    : public details::robin_hood_table<Key, T, Hash, KeyEqual, Allocator, GrowthPolicy, StoreHash, EpochClear>
 {
-public:
-    using GrowthPolicy::compute_index;
-    using GrowthPolicy::compute_closest_capacity;
-    using GrowthPolicy::minimum_capacity;
-
-    using key_type        = Key;
-    using mapped_type     = T;
-    using value_type      = std::pair<Key, T>;
-    using size_type       = std::size_t;
-    using hasher          = Hash;
-    using key_equal       = KeyEqual;
-    using allocator_type  = Allocator;
-    using reference       = value_type &;
-    using const_reference = const value_type &;
-    using buckets         = std::vector<value_type, allocator_type>;
-
-    template <typename ContT, typename IterVal> 
-    struct hash_map_iterator 
-    {
-        using difference_type   = std::ptrdiff_t;
-        using value_type        = IterVal;
-        using pointer           = value_type*;
-        using reference         = value_type&;
-        using iterator_category = std::forward_iterator_tag;
-
-        bool operator==(const hash_map_iterator &other) const 
-        {
-            return other.hm_ == hm_ && other.idx_ == idx_;
-        }
-
-        bool operator!=(const hash_map_iterator &other) const 
-        {
-            return !(other == *this);
-        }
-
-        hash_map_iterator &operator++() 
-        {
-            ++idx_;
-            advance_past_empty();
-            return *this;
-        }
-
-        reference operator*() const 
-        { 
-            return hm_->m_buckets[idx_]; 
-        }
-        
-        pointer operator->() const 
-        { 
-            return &hm_->m_buckets[idx_]; 
-        }
-
-    private:
-        explicit hash_map_iterator(ContT* hm) : hm_(hm) 
-        { 
-            advance_past_empty(); 
-        }
-
-        explicit hash_map_iterator(ContT* hm, size_type idx) : hm_(hm), idx_(idx) { }
-
-        template <typename OtherContT, typename OtherIterVal>
-        hash_map_iterator(const hash_map_iterator<OtherContT, OtherIterVal>& other)
-            : hm_(other.hm_), idx_(other.idx_) {}
-
-        void advance_past_empty() 
-        {
-            while (idx_ < hm_->m_buckets.size() &&
-                key_equal()(hm_->m_buckets[idx_].first, hm_->m_empty_key)) 
-            {
-                ++idx_;
-            }
-        }
-
-        ContT* hm_ = nullptr;
-        typename ContT::size_type idx_ = 0;
-        friend ContT;
-    };
+    using base = details::robin_hood_table<Key, T, Hash, KeyEqual, Allocator, GrowthPolicy, StoreHash, EpochClear>;
 
-    using iterator       = hash_map_iterator<hash_map, value_type>;
-    using const_iterator = hash_map_iterator<const hash_map, const value_type>;
+    template <typename K>
+    using enable_if_transparent = typename base::template enable_if_transparent<K>;
 
 public:
-    hash_map() : hash_map(minimum_capacity(), key_type())
-    { }
-
-    hash_map(size_type bucket_count) : hash_map(bucket_count, key_type())
-    { }
-
-    hash_map(size_type bucket_count, key_type empty_key,
-            const allocator_type &alloc = allocator_type())
-        : m_empty_key(empty_key), m_buckets(alloc) 
-    {
-        std::size_t count = compute_closest_capacity(bucket_count);
-        m_buckets.resize(count, std::make_pair(m_empty_key, T()));
-    }
-
-    hash_map(const hash_map &other, size_type bucket_count)
-        : hash_map(bucket_count, other.m_empty_key, other.get_allocator()) 
-    {
-        for (auto it = other.cbegin(); it != other.cend(); ++it) 
-        {
-            insert(*it);
-        }
-    }
-
-    allocator_type get_allocator() const noexcept 
-    {
-        return m_buckets.get_allocator();
-    }
-
-    // Iterators
-    iterator begin() noexcept 
-    { 
-        return iterator(this); 
-    }
-
-    const_iterator begin() const noexcept 
-    { 
-        return const_iterator(this); 
-    }
-
-    const_iterator cbegin() const noexcept 
-    { 
-        return const_iterator(this); 
-    }
-
-    iterator end() noexcept 
-    { 
-        return iterator(this, m_buckets.size()); 
-    }
-
-    const_iterator end() const noexcept 
-    {
-        return const_iterator(this, m_buckets.size());
-    }
-
-    const_iterator cend() const noexcept 
-    {
-        return const_iterator(this, m_buckets.size());
-    }
-
-    // Capacity
-    bool empty() const noexcept 
-    { 
-        return size() == 0; 
-    }
-
-    size_type size() const noexcept
-    { 
-        return m_size; 
-    }
-
-    size_type max_size() const noexcept 
-    { 
-        return m_buckets.max_size() / 2; 
-    }
+    using key_type        = typename base::key_type;
+    using mapped_type     = T;
+    using value_type      = typename base::value_type;
+    using size_type       = typename base::size_type;
+    using hasher          = typename base::hasher;
+    using key_equal       = typename base::key_equal;
+    using allocator_type  = typename base::allocator_type;
+    using reference       = typename base::reference;
+    using const_reference = typename base::const_reference;
+    using iterator        = typename base::iterator;
+    using const_iterator  = typename base::const_iterator;
+
+    using base::base;
 
     // Modifiers
-    void clear() noexcept 
+    // Build the value from args only if key is not in the map yet
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const key_type &key, Args &&... args) 
     {
-        for (auto& b : m_buckets) 
-        {
-            if (b.first != m_empty_key) 
-            {
-                b.first = m_empty_key;
-            }
-        }
-        m_size = 0;
+        return this->emplace_impl(key, std::forward<Args>(args)...);
     }
 
-    std::pair<iterator, bool> insert(const value_type &value) 
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(key_type &&key, Args &&... args) 
     {
-        return emplace_impl(value.first, value.second);
+        return this->emplace_impl(std::move(key), std::forward<Args>(args)...);
     }
 
-    std::pair<iterator, bool> insert(value_type&& value) 
+    // key_type is built from key only on insertion
+    template <typename K, typename... Args, enable_if_transparent<K> = 0>
+    std::pair<iterator, bool> try_emplace(K &&key, Args &&... args) 
     {
-        return emplace_impl(value.first, std::move(value.second));
+        return this->emplace_impl(std::forward<K>(key), std::forward<Args>(args)...);
     }
 
-    template <typename... Args>
-    std::pair<iterator, bool> emplace(Args &&... args) 
+    template <typename M>
+    std::pair<iterator, bool> insert_or_assign(const key_type &key, M &&obj) 
     {
-        return emplace_impl(std::forward<Args>(args)...);
-    }
-
-    void erase(iterator it) 
-    { 
-        erase_impl(it); 
+        return insert_or_assign_impl(key, std::forward<M>(obj));
     }
 
-    size_type erase(const key_type &key) 
-    { 
-        return erase_impl(key); 
-    }
-
-    template <typename K> 
-    size_type erase(const K& x) 
-    { 
-        return erase_impl(x); 
+    template <typename M>
+    std::pair<iterator, bool> insert_or_assign(key_type &&key, M &&obj) 
+    {
+        return insert_or_assign_impl(std::move(key), std::forward<M>(obj));
     }
 
-    void swap(hash_map &other) noexcept 
+    template <typename K, typename M, enable_if_transparent<K> = 0>
+    std::pair<iterator, bool> insert_or_assign(K &&key, M &&obj) 
     {
-        std::swap(m_buckets, other.m_buckets);
-        std::swap(m_size, other.m_size);
-        std::swap(m_empty_key, other.m_empty_key);
+        return insert_or_assign_impl(std::forward<K>(key), std::forward<M>(obj));
     }
 
     // Lookup
@@ -268,8 +166,8 @@ public:
         return at_impl(key); 
     }
 
-    template <typename K> 
-    mapped_type &at(const K &x) 
+    template <typename K, enable_if_transparent<K> = 0> 
+    mapped_type &at(const K &x)
     { 
         return at_impl(x); 
     }
@@ -279,166 +177,34 @@ public:
         return at_impl(key); 
     }
 
-    template <typename K> 
-    const mapped_type &at(const K &x) const 
+    template <typename K, enable_if_transparent<K> = 0> 
+    const mapped_type &at(const K &x) const
     {
         return at_impl(x);
     }
 
     mapped_type &operator[](const key_type &key) 
     {
-        return emplace_impl(key).first->second;
-    }
-
-    size_type count(const key_type &key) const 
-    { 
-        return count_impl(key); 
-    }
-
-    template <typename K> 
-    size_type count(const K &x) const 
-    {
-        return count_impl(x);
-    }
-
-    iterator find(const key_type &key) 
-    { 
-        return find_impl(key); 
-    }
-
-    template <typename K> 
-    iterator find(const K &x) 
-    { 
-        return find_impl(x); 
-    }
-
-    const_iterator find(const key_type &key) const 
-    { 
-        return find_impl(key); 
-    }
-
-    template <typename K> 
-    const_iterator find(const K &x) const 
-    {
-        return find_impl(x);
-    }
-
-    // Bucket interface
-    size_type bucket_count() const noexcept 
-    { 
-        return m_buckets.size(); 
-    }
-
-    size_type max_bucket_count() const noexcept 
-    { 
-        return m_buckets.max_size(); 
-    }
-
-    // Hash policy
-    float max_load_factor() const noexcept 
-    { 
-        return m_max_load_factor; 
-    }
-
-    void rehash(size_type count) 
-    {
-        count = std::max(minimum_capacity(), count);
-        count = std::max(count, static_cast<size_type>(size() / max_load_factor()));
-
-        count = compute_closest_capacity(count);
-        hash_map other(*this, count);
-        swap(other);
+        return this->emplace_impl(key).first->second;
     }
 
-    void reserve(std::size_t count)
+    mapped_type &operator[](key_type &&key) 
     {
-        rehash(std::ceil(count / max_load_factor()));
+        return this->emplace_impl(std::move(key)).first->second;
     }
 
-    void check_for_rehash()
+    template <typename K, enable_if_transparent<K> = 0> 
+    mapped_type &operator[](K &&key) 
     {
-        if (size() + 1 > bucket_count() * max_load_factor())
-        {
-            rehash(bucket_count() << 2);
-        }
-    }
-
-    // Observers
-    hasher hash_function() const 
-    { 
-        return hasher(); 
-    }
-
-    key_equal key_eq() const 
-    { 
-        return key_equal(); 
+        return this->emplace_impl(std::forward<K>(key)).first->second;
     }
 
 private:
-    template <typename K, typename... Args>
-    std::pair<iterator, bool> emplace_impl(const K& key, Args&& ...args) 
-    {
-        assert(!key_equal()(m_empty_key, key) && "empty key shouldn't be used");
-
-        check_for_rehash();
-
-        for (size_t idx = key_to_idx(key); ; idx = probe_next(idx)) 
-        {
-            if (key_equal()(m_buckets[idx].first, m_empty_key)) 
-            {
-                m_buckets[idx].second = mapped_type(std::forward<Args>(args)...);
-                m_buckets[idx].first = key;
-                m_size++;
-                return {iterator(this, idx), true};
-            } 
-            else if (key_equal()(m_buckets[idx].first, key)) 
-            {
-                return {iterator(this, idx), false};
-            }
-        }
-    }
-
-    void erase_impl(iterator it) 
-    {
-        size_t bucket = it.idx_;
-
-        for (size_t idx = probe_next(bucket); ; idx = probe_next(idx)) 
-        {
-            if (key_equal()(m_buckets[idx].first, m_empty_key)) 
-            {
-                m_buckets[bucket].first = m_empty_key;
-                --m_size;
-
-                return;
-            }
-
-            size_t ideal = key_to_idx(m_buckets[idx].first);
-            if (diff(bucket, ideal) < diff(idx, ideal)) 
-            {
-                // swap, bucket is closer to ideal than idx
-                m_buckets[bucket] = m_buckets[idx];
-                bucket = idx;
-            }
-        }
-    }
-
-    template <typename K> 
-    size_type erase_impl(const K &key) 
-    {
-        auto it = find_impl(key);
-        if (it != end()) {
-            erase_impl(it);
-            return 1;
-        }
-
-        return 0;
-    }
-
     template <typename K> 
     mapped_type &at_impl(const K &key) 
     {
-        iterator it = find_impl(key);
-        if (it != end()) 
+        iterator it = this->find_impl(key);
+        if (it != this->end()) 
         {
             return it->second;
         }
@@ -451,57 +217,43 @@ private:
         return const_cast<hash_map*>(this)->at_impl(key);
     }
 
-    template <typename K> 
-    size_t count_impl(const K& key) const 
-    {
-        return find_impl(key) == end() ? 0 : 1;
-    }
-
-    template <typename K> 
-    iterator find_impl(const K &key) 
+    template <typename K, typename M>
+    std::pair<iterator, bool> insert_or_assign_impl(K&& key, M&& obj) 
     {
-        assert(!key_equal()(m_empty_key, key) && "empty key shouldn't be used");
-
-        for (size_t idx = key_to_idx(key); ; idx = probe_next(idx)) 
+        auto res = this->emplace_impl(std::forward<K>(key), std::forward<M>(obj));
+        if (!res.second)
         {
-            if (key_equal()(m_buckets[idx].first, key)) 
-            {
-                return iterator(this, idx);
-            }
-
-            if (key_equal()(m_buckets[idx].first, m_empty_key)) 
-            {
-                return end();
-            }
+            // obj was left untouched by the failed emplace
+            res.first->second = std::forward<M>(obj);
         }
+        return res;
     }
+};
 
-    template <typename K> 
-    const_iterator find_impl(const K &key) const 
-    {
-        return const_cast<hash_map*>(this)->find_impl(key);
-    }
-
-    template <typename K>
-    size_t key_to_idx(const K& key) const noexcept(noexcept(hasher()(key))) 
-    {
-        return compute_index(hasher()(key), m_buckets.size());
-    }
+// Erases the elements pred is true for in one pass, see robin_hood_table::erase_if
+template <typename Key, typename T, typename Hash, typename KeyEqual, typename Allocator,
+          typename GrowthPolicy, bool StoreHash, bool EpochClear, typename Pred>
+typename hash_map<Key, T, Hash, KeyEqual, Allocator, GrowthPolicy, StoreHash, EpochClear>::size_type
+erase_if(hash_map<Key, T, Hash, KeyEqual, Allocator, GrowthPolicy, StoreHash, EpochClear> &map, Pred pred)
+{
+    return map.erase_if(pred);
+}
 
-    size_t probe_next(size_t idx) const noexcept 
-    {
-        return compute_index(idx + 1, m_buckets.size());
-    }
+namespace pmr
+{
 
-    size_t diff(size_t a, size_t b) const noexcept 
-    {
-        return compute_index(m_buckets.size() + (a - b), m_buckets.size());
-    }
+// Allocates from a std::pmr::memory_resource, e.g. a request scoped
+// std::pmr::monotonic_buffer_resource released at once with all its maps
+template <typename Key,
+          typename T,
+          typename Hash         = std::hash<Key>,
+          typename KeyEqual     = std::equal_to<void>,
+          typename GrowthPolicy = details::power_of_two_growth_policy<>,
+          bool StoreHash        = false,
+          bool EpochClear       = false>
+using hash_map = jw::hash_map<Key, T, Hash, KeyEqual,
+                              std::pmr::polymorphic_allocator<std::pair<Key, T>>,
+                              GrowthPolicy, StoreHash, EpochClear>;
 
-private:
-    key_type m_empty_key;
-    buckets  m_buckets;
-    size_t   m_size            = 0;
-    float    m_max_load_factor = DEFAULT_MAX_LOAD_FACTOR;
-};
+}
 }
@@ -0,0 +1,78 @@
+/**
+ * @file hash_set.h
+ * @author jian wu (jian.wu_93@foxmail.com)
+ * @brief Set of keys on the Robin Hood table of jw::hash_map.
+ *
+ * Buckets hold the keys alone, so the set has the probing, growth, erase
+ * shift, batches, clear and stats of jw::hash_map without paying for a
+ * mapped value. Keys are constant through the iterators.
+ *
+ * The default constructed key is the empty key, as for jw::hash_map, unless
+ * keys are integral or enums.
+ *
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ *
+ */
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <memory_resource>
+
+#include "robin_hood_table.h"
+
+namespace jw
+{
+
+template <typename Key,
+          typename Hash         = std::hash<Key>,
+          typename KeyEqual     = std::equal_to<void>,
+          typename Allocator    = std::allocator<Key>,
+          typename GrowthPolicy = details::power_of_two_growth_policy<>,
+          bool StoreHash        = false,
+          bool EpochClear       = false>
+class hash_set
+    : public details::robin_hood_table<Key, void, Hash, KeyEqual, Allocator, GrowthPolicy, StoreHash, EpochClear>
+{
+    using base = details::robin_hood_table<Key, void, Hash, KeyEqual, Allocator, GrowthPolicy, StoreHash, EpochClear>;
+
+public:
+    using key_type        = typename base::key_type;
+    using value_type      = typename base::value_type;
+    using size_type       = typename base::size_type;
+    using hasher          = typename base::hasher;
+    using key_equal       = typename base::key_equal;
+    using allocator_type  = typename base::allocator_type;
+    using reference       = typename base::reference;
+    using const_reference = typename base::const_reference;
+    using iterator        = typename base::iterator;
+    using const_iterator  = typename base::const_iterator;
+
+    using base::base;
+};
+
+// Erases the elements pred is true for in one pass, see robin_hood_table::erase_if
+template <typename Key, typename Hash, typename KeyEqual, typename Allocator,
+          typename GrowthPolicy, bool StoreHash, bool EpochClear, typename Pred>
+typename hash_set<Key, Hash, KeyEqual, Allocator, GrowthPolicy, StoreHash, EpochClear>::size_type
+erase_if(hash_set<Key, Hash, KeyEqual, Allocator, GrowthPolicy, StoreHash, EpochClear> &set, Pred pred)
+{
+    return set.erase_if(pred);
+}
+
+namespace pmr
+{
+
+template <typename Key,
+          typename Hash         = std::hash<Key>,
+          typename KeyEqual     = std::equal_to<void>,
+          typename GrowthPolicy = details::power_of_two_growth_policy<>,
+          bool StoreHash        = false,
+          bool EpochClear       = false>
+using hash_set = jw::hash_set<Key, Hash, KeyEqual, std::pmr::polymorphic_allocator<Key>,
+                              GrowthPolicy, StoreHash, EpochClear>;
+
+}
+}
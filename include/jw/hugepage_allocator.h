@@ -0,0 +1,144 @@
+/**
+ * @file hugepage_allocator.h
+ * @author jian wu (jian.wu_93@foxmail.com)
+ * @brief Allocator backing big allocations (bucket arrays) with 2 MiB pages.
+ *
+ * Allocations of at least ALLOC_HUGE_PAGE_THRESHOLD bytes are rounded up to a
+ * multiple of HUGE_PAGE_SIZE and mapped with mmap:
+ * 1. MAP_HUGETLB first, which needs pages reserved in /proc/sys/vm/nr_hugepages
+ * 2. otherwise a 2 MiB aligned anonymous mapping with madvise(MADV_HUGEPAGE),
+ *    backed by transparent huge pages when they are enabled (always or madvise)
+ * Smaller allocations go to std::allocator. A random probe into a table of
+ * hundreds of MB then costs one TLB entry per 2 MiB instead of per 4 KiB.
+ * The rounding maps at most twice what is asked for above the threshold,
+ * jw::count::count_allocator over this allocator still counts the bytes
+ * asked for.
+ *
+ * Platforms without mmap use std::allocator for every size.
+ *
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ *
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#define JW_HAVE_MMAP 1
+#endif
+
+namespace jw
+{
+
+template <typename T>
+class hugepage_allocator
+{
+public:
+    constexpr static std::size_t HUGE_PAGE_SIZE            = 1 << 21; // 2 MiB
+    // Half a huge page: smaller tables would pin a whole 2 MiB page each
+    constexpr static std::size_t ALLOC_HUGE_PAGE_THRESHOLD = HUGE_PAGE_SIZE / 2; // 1 MiB
+
+    using value_type = T;
+
+    hugepage_allocator() = default;
+
+    template <class U>
+    constexpr hugepage_allocator(const hugepage_allocator<U> &) noexcept
+    { }
+
+    hugepage_allocator(const hugepage_allocator&) = default;
+
+    friend bool operator==(const hugepage_allocator&, const hugepage_allocator&)
+    {
+        return true;
+    }
+
+    friend bool operator!=(const hugepage_allocator&, const hugepage_allocator&)
+    {
+        return false;
+    }
+
+    value_type* allocate(std::size_t n)
+    {
+        const std::size_t bytes = n * sizeof(value_type);
+#ifdef JW_HAVE_MMAP
+        if (bytes >= ALLOC_HUGE_PAGE_THRESHOLD)
+        {
+            return static_cast<value_type*>(map_huge(mapped_size(bytes)));
+        }
+#endif
+        (void)bytes;
+        return std::allocator<value_type>().allocate(n);
+    }
+
+    void deallocate(T* p, std::size_t n)
+    {
+        const std::size_t bytes = n * sizeof(value_type);
+#ifdef JW_HAVE_MMAP
+        if (bytes >= ALLOC_HUGE_PAGE_THRESHOLD)
+        {
+            ::munmap(p, mapped_size(bytes));
+            return;
+        }
+#endif
+        (void)bytes;
+        std::allocator<value_type>().deallocate(p, n);
+    }
+
+private:
+    static std::size_t mapped_size(std::size_t bytes) noexcept
+    {
+        return (bytes + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    }
+
+#ifdef JW_HAVE_MMAP
+    static void* map_huge(std::size_t size)
+    {
+#ifdef MAP_HUGETLB
+        void* huge = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (huge != MAP_FAILED)
+        {
+            return huge;
+        }
+#endif
+
+        // Map one huge page more to align the start, then trim both ends
+        const std::size_t padded = size + HUGE_PAGE_SIZE;
+        void* raw = ::mmap(nullptr, padded, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (raw == MAP_FAILED)
+        {
+            throw std::bad_alloc();
+        }
+
+        const std::uintptr_t start   = reinterpret_cast<std::uintptr_t>(raw);
+        const std::uintptr_t aligned = (start + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+        const std::size_t    head    = aligned - start;
+        const std::size_t    tail    = padded - head - size;
+
+        if (head != 0)
+        {
+            ::munmap(raw, head);
+        }
+        if (tail != 0)
+        {
+            ::munmap(reinterpret_cast<void*>(aligned + size), tail);
+        }
+
+        void* p = reinterpret_cast<void*>(aligned);
+#ifdef MADV_HUGEPAGE
+        ::madvise(p, size, MADV_HUGEPAGE);
+#endif
+        return p;
+    }
+#endif
+};
+
+}
@@ -0,0 +1,560 @@
+/**
+ * @file incremental_hash_map.h
+ * @author jian wu (jian.wu_93@foxmail.com)
+ * @brief jw::hash_map with incremental (amortized) rehashing.
+ *
+ * When the active table is full, instead of migrating every bucket on a single
+ * insert, a bigger table becomes the active one and the old table is kept
+ * aside. Every insert, erase and non-const find then moves a bounded number of
+ * buckets from the old table into the active one, lookups consult both tables
+ * until the old table is drained. The worst-case insert latency is bounded by
+ * the allocation of the new bucket array plus migration_step() bucket moves.
+ *
+ * Any modifier and the non-const find() may migrate buckets, so they
+ * invalidate iterators of the map.
+ *
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "hash_map.h"
+
+namespace jw
+{
+
+static constexpr const std::size_t DEFAULT_MIGRATION_STEP = 16;
+static constexpr const std::size_t MINIMUM_MIGRATION_STEP = 2;
+
+template <typename Key,
+          typename T,
+          typename Hash         = std::hash<Key>,
+          typename KeyEqual     = std::equal_to<void>,
+          typename Allocator    = std::allocator<std::pair<Key, T>>,
+          typename GrowthPolicy = details::power_of_two_growth_policy<>,
+          bool StoreHash        = false>
+class incremental_hash_map
+{
+public:
+    using table           = hash_map<Key, T, Hash, KeyEqual, Allocator, GrowthPolicy, StoreHash>;
+    using key_type        = typename table::key_type;
+    using mapped_type     = typename table::mapped_type;
+    using value_type      = typename table::value_type;
+    using size_type       = typename table::size_type;
+    using hasher          = typename table::hasher;
+    using key_equal       = typename table::key_equal;
+    using allocator_type  = typename table::allocator_type;
+    using reference       = typename table::reference;
+    using const_reference = typename table::const_reference;
+
+    template <typename ContT, typename TableIter, typename IterVal>
+    struct incremental_iterator
+    {
+        using difference_type   = std::ptrdiff_t;
+        using value_type        = IterVal;
+        using pointer           = value_type*;
+        using reference         = value_type&;
+        using iterator_category = std::forward_iterator_tag;
+
+        // end() compares equal whatever the state of the migration was when
+        // the iterators were created
+        bool operator==(const incremental_iterator &other) const
+        {
+            return other.at_end_ == at_end_ &&
+                (at_end_ || (other.in_old_ == in_old_ && other.it_ == it_));
+        }
+
+        bool operator!=(const incremental_iterator &other) const
+        {
+            return !(other == *this);
+        }
+
+        incremental_iterator &operator++()
+        {
+            ++it_;
+            advance_past_active();
+            return *this;
+        }
+
+        reference operator*() const
+        {
+            return *it_;
+        }
+
+        pointer operator->() const
+        {
+            return &*it_;
+        }
+
+    private:
+        incremental_iterator(ContT* hm, TableIter it, bool in_old)
+            : hm_(hm), it_(it), in_old_(in_old)
+        {
+            advance_past_active();
+        }
+
+        explicit incremental_iterator(ContT* hm)
+            : hm_(hm), it_(hm->m_old.end()), in_old_(true), at_end_(true) { }
+
+        // The active table is walked first, then whatever is left in the old one
+        void advance_past_active()
+        {
+            if (!in_old_ && it_ == hm_->m_active.end())
+            {
+                in_old_ = true;
+                it_     = hm_->m_old.begin();
+            }
+
+            at_end_ = in_old_ && it_ == hm_->m_old.end();
+        }
+
+        ContT*    hm_ = nullptr;
+        TableIter it_;
+        bool      in_old_ = false;
+        bool      at_end_ = false;
+        friend ContT;
+    };
+
+    using iterator       = incremental_iterator<incremental_hash_map,
+                                                typename table::iterator,
+                                                value_type>;
+    using const_iterator = incremental_iterator<const incremental_hash_map,
+                                                typename table::const_iterator,
+                                                const value_type>;
+
+private:
+    // Heterogeneous lookup needs both Hash and KeyEqual transparent, as in
+    // the tables, other keys are converted to key_type first
+    template <typename K>
+    static constexpr bool is_transparent_key = details::is_transparent<Hash>::value &&
+        details::is_transparent<KeyEqual>::value &&
+        !std::is_convertible<K, iterator>::value && !std::is_convertible<K, const_iterator>::value;
+
+    template <typename K>
+    using enable_if_transparent = std::enable_if_t<is_transparent_key<K>, int>;
+
+public:
+    incremental_hash_map() : incremental_hash_map(GrowthPolicy::minimum_capacity())
+    { }
+
+    incremental_hash_map(size_type bucket_count) : incremental_hash_map(bucket_count, key_type())
+    { }
+
+    explicit incremental_hash_map(const allocator_type &alloc)
+        : incremental_hash_map(GrowthPolicy::minimum_capacity(), key_type(), alloc)
+    { }
+
+    incremental_hash_map(size_type bucket_count, const allocator_type &alloc)
+        : incremental_hash_map(bucket_count, key_type(), alloc)
+    { }
+
+    incremental_hash_map(size_type bucket_count, key_type empty_key,
+                         const allocator_type &alloc = allocator_type())
+        : m_active(bucket_count, empty_key, alloc),
+          m_old(GrowthPolicy::minimum_capacity(), empty_key, alloc)
+    { }
+
+    allocator_type get_allocator() const noexcept
+    {
+        return m_active.get_allocator();
+    }
+
+    // Iterators
+    iterator begin() noexcept
+    {
+        return iterator(this, m_active.begin(), false);
+    }
+
+    const_iterator begin() const noexcept
+    {
+        return const_iterator(this, m_active.begin(), false);
+    }
+
+    const_iterator cbegin() const noexcept
+    {
+        return begin();
+    }
+
+    iterator end() noexcept
+    {
+        return iterator(this);
+    }
+
+    const_iterator end() const noexcept
+    {
+        return const_iterator(this);
+    }
+
+    const_iterator cend() const noexcept
+    {
+        return end();
+    }
+
+    // Capacity
+    bool empty() const noexcept
+    {
+        return size() == 0;
+    }
+
+    size_type size() const noexcept
+    {
+        return m_active.size() + m_old.size();
+    }
+
+    size_type max_size() const noexcept
+    {
+        return m_active.max_size();
+    }
+
+    // Modifiers
+    void clear() noexcept
+    {
+        m_active.clear();
+        m_old.clear();
+        m_migrating = false;
+    }
+
+    std::pair<iterator, bool> insert(const value_type &value)
+    {
+        return emplace_impl(value.first, value.second);
+    }
+
+    std::pair<iterator, bool> insert(value_type&& value)
+    {
+        return emplace_impl(value.first, std::move(value.second));
+    }
+
+    template <typename... Args>
+    std::pair<iterator, bool> emplace(Args &&... args)
+    {
+        return emplace_impl(std::forward<Args>(args)...);
+    }
+
+    void erase(iterator it)
+    {
+        if (it.in_old_)
+        {
+            m_old.erase(it.it_);
+        }
+        else
+        {
+            m_active.erase(it.it_);
+        }
+    }
+
+    size_type erase(const key_type &key)
+    {
+        return erase_impl(key);
+    }
+
+    template <typename K, enable_if_transparent<K> = 0>
+    size_type erase(const K& x)
+    {
+        return erase_impl(x);
+    }
+
+    void swap(incremental_hash_map &other) noexcept
+    {
+        m_active.swap(other.m_active);
+        m_old.swap(other.m_old);
+        std::swap(m_cursor, other.m_cursor);
+        std::swap(m_step, other.m_step);
+        std::swap(m_migrating, other.m_migrating);
+    }
+
+    // Lookup
+    mapped_type &at(const key_type &key)
+    {
+        return at_impl(key);
+    }
+
+    template <typename K, enable_if_transparent<K> = 0>
+    mapped_type &at(const K &x)
+    {
+        return at_impl(x);
+    }
+
+    const mapped_type &at(const key_type &key) const
+    {
+        return at_impl(key);
+    }
+
+    template <typename K, enable_if_transparent<K> = 0>
+    const mapped_type &at(const K &x) const
+    {
+        return at_impl(x);
+    }
+
+    mapped_type &operator[](const key_type &key)
+    {
+        return emplace_impl(key).first->second;
+    }
+
+    size_type count(const key_type &key) const
+    {
+        return find(key) == end() ? 0 : 1;
+    }
+
+    template <typename K, enable_if_transparent<K> = 0>
+    size_type count(const K &x) const
+    {
+        return find(x) == end() ? 0 : 1;
+    }
+
+    iterator find(const key_type &key)
+    {
+        return find_impl(key);
+    }
+
+    template <typename K, enable_if_transparent<K> = 0>
+    iterator find(const K &x)
+    {
+        return find_impl(x);
+    }
+
+    const_iterator find(const key_type &key) const
+    {
+        return find_impl(key);
+    }
+
+    template <typename K, enable_if_transparent<K> = 0>
+    const_iterator find(const K &x) const
+    {
+        return find_impl(x);
+    }
+
+    // Bucket interface
+    size_type bucket_count() const noexcept
+    {
+        return m_active.bucket_count();
+    }
+
+    size_type max_bucket_count() const noexcept
+    {
+        return m_active.max_bucket_count();
+    }
+
+    // Hash policy
+    float max_load_factor() const noexcept
+    {
+        return m_active.max_load_factor();
+    }
+
+    void max_load_factor(float ml)
+    {
+        finish_migration();
+        m_active.max_load_factor(ml);
+    }
+
+    void rehash(size_type count)
+    {
+        finish_migration();
+        m_active.rehash(count);
+    }
+
+    void reserve(std::size_t count)
+    {
+        finish_migration();
+        m_active.reserve(count);
+    }
+
+    // Buckets moved from the old table per insert/erase/find
+    size_type migration_step() const noexcept
+    {
+        return m_step;
+    }
+
+    void migration_step(size_type step) noexcept
+    {
+        m_step = std::max(step, MINIMUM_MIGRATION_STEP);
+    }
+
+    bool migrating() const noexcept
+    {
+        return m_migrating;
+    }
+
+    // Observers
+    hasher hash_function() const
+    {
+        return hasher();
+    }
+
+    key_equal key_eq() const
+    {
+        return key_equal();
+    }
+
+private:
+    template <typename K, typename... Args>
+    std::pair<iterator, bool> emplace_impl(const K& key, Args&& ...args)
+    {
+        migrate(m_step);
+
+        if (m_active.needs_rehash())
+        {
+            start_migration();
+        }
+
+        if (m_migrating)
+        {
+            auto it = m_old.find(key);
+            if (it != m_old.end())
+            {
+                return {iterator(this, it, true), false};
+            }
+        }
+
+        auto res = m_active.emplace(key, std::forward<Args>(args)...);
+        return {iterator(this, res.first, false), res.second};
+    }
+
+    template <typename K>
+    size_type erase_impl(const K &key)
+    {
+        migrate(m_step);
+
+        if (m_active.erase(key) != 0)
+        {
+            return 1;
+        }
+
+        return m_migrating ? m_old.erase(key) : 0;
+    }
+
+    template <typename K>
+    mapped_type &at_impl(const K &key)
+    {
+        iterator it = find_impl(key);
+        if (it != end())
+        {
+            return it->second;
+        }
+        throw std::out_of_range("incremental_hash_map::at");
+    }
+
+    template <typename K>
+    const mapped_type &at_impl(const K &key) const
+    {
+        const_iterator it = find_impl(key);
+        if (it != end())
+        {
+            return it->second;
+        }
+        throw std::out_of_range("incremental_hash_map::at");
+    }
+
+    template <typename K>
+    iterator find_impl(const K &key)
+    {
+        migrate(m_step);
+
+        auto it = m_active.find(key);
+        if (it != m_active.end())
+        {
+            return iterator(this, it, false);
+        }
+
+        return m_migrating ? iterator(this, m_old.find(key), true) : end();
+    }
+
+    template <typename K>
+    const_iterator find_impl(const K &key) const
+    {
+        auto it = m_active.find(key);
+        if (it != m_active.end())
+        {
+            return const_iterator(this, it, false);
+        }
+
+        return m_migrating ? const_iterator(this, m_old.find(key), true) : end();
+    }
+
+    // The active table becomes the old one, a bigger empty table takes over
+    void start_migration()
+    {
+        finish_migration();
+
+        table next(m_active.next_capacity(), m_active.m_empty_key, m_active.get_allocator());
+        next.m_max_load_factor = m_active.m_max_load_factor;
+
+        m_old.swap(m_active);
+        m_active.swap(next);
+
+        m_cursor    = 0;
+        m_migrating = true;
+    }
+
+    void migrate(size_type step)
+    {
+        if (!m_migrating)
+        {
+            return;
+        }
+
+        // Fallback if the active table fills up before the old one is
+        // drained (tiny migration step or growth factor)
+        const size_type incoming = std::min(step, m_old.size()) + 1;
+        if (m_active.size() + incoming > m_active.bucket_count() * m_active.max_load_factor())
+        {
+            m_active.reserve(m_active.size() + m_old.size() + 1);
+        }
+
+        const size_type old_count = m_old.bucket_count();
+        for (; step > 0 && m_cursor < old_count; --step)
+        {
+            // Erasing shifts the following buckets back, the cursor only
+            // moves on once its bucket stays empty
+            if (!m_old.migrate_bucket(m_cursor, m_active))
+            {
+                ++m_cursor;
+            }
+        }
+
+        if (m_cursor == old_count)
+        {
+            table drained(GrowthPolicy::minimum_capacity(), m_old.m_empty_key, m_old.get_allocator());
+            m_old.swap(drained);
+            m_migrating = false;
+        }
+    }
+
+    void finish_migration()
+    {
+        if (m_migrating)
+        {
+            migrate(m_old.bucket_count() + m_old.size());
+        }
+    }
+
+private:
+    table     m_active;
+    table     m_old;
+    size_type m_cursor    = 0;
+    size_type m_step      = DEFAULT_MIGRATION_STEP;
+    bool      m_migrating = false;
+};
+
+namespace pmr
+{
+
+template <typename Key,
+          typename T,
+          typename Hash         = std::hash<Key>,
+          typename KeyEqual     = std::equal_to<void>,
+          typename GrowthPolicy = details::power_of_two_growth_policy<>,
+          bool StoreHash        = false>
+using incremental_hash_map = jw::incremental_hash_map<Key, T, Hash, KeyEqual,
+                                                      std::pmr::polymorphic_allocator<std::pair<Key, T>>,
+                                                      GrowthPolicy, StoreHash>;
+
+}
+}
@@ -0,0 +1,604 @@
+/**
+ * @file mapped_hash_map.h
+ * @author jian wu (jian.wu_93@foxmail.com)
+ * @brief Read-only jw::hash_map served straight from a file mapping.
+ *
+ * mapped_hash_map::save() writes the bucket array of a jw::hash_map with
+ * trivially copyable Key and T, as it is in memory, to a versioned file:
+ *
+ *   mapped_header   magic, version, layout sizes, hasher and growth policy
+ *                   fingerprints, bucket count and size
+ *   empty key
+ *   bucket infos    probe distance (and hash with StoreHash) per bucket
+ *   buckets         std::pair<Key, T> per bucket, zeros when empty
+ *
+ * every section starting on a MAPPED_ALIGNMENT boundary. A mapped_hash_map
+ * opens such a file with mmap(PROT_READ, MAP_SHARED) and probes the mapping
+ * the way jw::hash_map probes its buckets: nothing is deserialized, pages are
+ * read on first touch and every process mapping the file shares the page
+ * cache copy. Platforms without mmap read the file into memory.
+ *
+ * Opening checks the header against the template arguments, and fails on a
+ * file written with another hasher, growth policy, layout or byte order. The
+ * buckets themselves are trusted.
+ *
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+#include "hash_map.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define JW_HAVE_MMAP 1
+#endif
+
+namespace jw
+{
+
+static constexpr const std::uint32_t MAPPED_VERSION   = 1;
+static constexpr const std::size_t   MAPPED_ALIGNMENT = 64;
+
+// Buckets staged per write when saving
+static constexpr const std::size_t MAPPED_WRITE_BUCKETS = 4096;
+
+namespace details
+{
+
+static constexpr const char         MAPPED_MAGIC[8]  = {'J', 'W', 'H', 'M', 'A', 'P', 0, 0};
+static constexpr const std::uint32_t MAPPED_BYTE_ORDER = 0x01020304;
+
+/**
+ * @brief First bytes of a mapped_hash_map file, the offsets are from the
+ * start of the file.
+ */
+struct mapped_header
+{
+    char          magic[8];
+    std::uint32_t version;
+    std::uint32_t byte_order;
+    std::uint64_t key_size;
+    std::uint64_t value_size;
+    std::uint64_t value_align;
+    std::uint64_t info_size;
+    std::uint64_t hasher_fingerprint;
+    std::uint64_t policy_fingerprint;
+    std::uint64_t bucket_count;
+    std::uint64_t size;
+    std::uint64_t empty_key_offset;
+    std::uint64_t infos_offset;
+    std::uint64_t buckets_offset;
+    std::uint64_t file_size;
+};
+
+inline std::uint64_t fnv1a(const void* data, std::size_t len,
+                           std::uint64_t h = 0xCBF29CE484222325ull) noexcept
+{
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (std::size_t i = 0; i < len; ++i)
+    {
+        h = (h ^ p[i]) * 0x100000001B3ull;
+    }
+    return h;
+}
+
+inline std::uint64_t type_fingerprint(const std::type_info &type) noexcept
+{
+    return fnv1a(type.name(), std::strlen(type.name()));
+}
+
+// The type of the hasher and the table hashes of a few keys, so a seeded or
+// otherwise changed hasher is caught too
+template <typename Hash, typename Key>
+std::uint64_t hasher_fingerprint()
+{
+    std::uint64_t h = type_fingerprint(typeid(Hash));
+
+    unsigned char bytes[sizeof(Key)];
+    for (unsigned char fill : {0x00, 0x5A, 0xA5})
+    {
+        std::memset(bytes, fill, sizeof(bytes));
+        Key key;
+        std::memcpy(static_cast<void*>(&key), bytes, sizeof(Key));
+
+        const std::uint64_t hash = table_hash<Hash>(Hash()(key));
+        h = fnv1a(&hash, sizeof(hash), h);
+    }
+    return h;
+}
+
+constexpr std::uint64_t align_up(std::uint64_t offset) noexcept
+{
+    return (offset + MAPPED_ALIGNMENT - 1) & ~std::uint64_t(MAPPED_ALIGNMENT - 1);
+}
+
+}
+
+template <typename Key,
+          typename T,
+          typename Hash         = std::hash<Key>,
+          typename KeyEqual     = std::equal_to<void>,
+          typename GrowthPolicy = details::power_of_two_growth_policy<>,
+          bool StoreHash        = false>
+class mapped_hash_map : private GrowthPolicy
+{
+    static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<T>::value,
+                  "mapped_hash_map stores keys and values as bytes");
+
+public:
+    using key_type        = Key;
+    using mapped_type     = T;
+    using value_type      = std::pair<Key, T>;
+    using size_type       = std::size_t;
+    using hasher          = Hash;
+    using key_equal       = KeyEqual;
+    using const_reference = const value_type &;
+    using bucket_info     = details::bucket_info<StoreHash>;
+
+    static_assert(alignof(value_type) <= MAPPED_ALIGNMENT, "buckets are aligned on MAPPED_ALIGNMENT");
+
+    struct const_iterator
+    {
+        using difference_type   = std::ptrdiff_t;
+        using value_type        = const typename mapped_hash_map::value_type;
+        using pointer           = value_type*;
+        using reference         = value_type&;
+        using iterator_category = std::forward_iterator_tag;
+
+        bool operator==(const const_iterator &other) const
+        {
+            return other.hm_ == hm_ && other.idx_ == idx_;
+        }
+
+        bool operator!=(const const_iterator &other) const
+        {
+            return !(other == *this);
+        }
+
+        const_iterator &operator++()
+        {
+            ++idx_;
+            advance_past_empty();
+            return *this;
+        }
+
+        reference operator*() const
+        {
+            return hm_->m_buckets[idx_];
+        }
+
+        pointer operator->() const
+        {
+            return &hm_->m_buckets[idx_];
+        }
+
+    private:
+        const_iterator(const mapped_hash_map* hm, size_type idx) : hm_(hm), idx_(idx) { }
+
+        void advance_past_empty()
+        {
+            while (idx_ < hm_->m_capacity && hm_->m_infos[idx_].empty())
+            {
+                ++idx_;
+            }
+        }
+
+        const mapped_hash_map* hm_  = nullptr;
+        size_type              idx_ = 0;
+        friend mapped_hash_map;
+    };
+
+    using iterator = const_iterator;
+
+public:
+    explicit mapped_hash_map(const std::string &path)
+    {
+        map_file(path);
+        try
+        {
+            attach(path);
+        }
+        catch (...)
+        {
+            unmap_file();
+            throw;
+        }
+    }
+
+    // The moved from map is empty and maps nothing, lookups return end()
+    mapped_hash_map(mapped_hash_map &&other) noexcept
+    {
+        swap(other);
+    }
+
+    mapped_hash_map &operator=(mapped_hash_map &&other) noexcept
+    {
+        if (this != &other)
+        {
+            // The previous mapping goes away with moved
+            mapped_hash_map moved(std::move(other));
+            swap(moved);
+        }
+        return *this;
+    }
+
+    mapped_hash_map(const mapped_hash_map&) = delete;
+    mapped_hash_map &operator=(const mapped_hash_map&) = delete;
+
+    ~mapped_hash_map()
+    {
+        unmap_file();
+    }
+
+    // Writes map to path, replacing the file
+    template <typename Allocator, bool EpochClear>
+    static void save(const hash_map<Key, T, Hash, KeyEqual, Allocator, GrowthPolicy, StoreHash, EpochClear> &map,
+                     const std::string &path)
+    {
+        using info_type = typename std::decay_t<decltype(map)>::bucket_info;
+
+        const size_type capacity = map.m_capacity;
+
+        details::mapped_header header{};
+        std::memcpy(header.magic, details::MAPPED_MAGIC, sizeof(header.magic));
+        header.version            = MAPPED_VERSION;
+        header.byte_order         = details::MAPPED_BYTE_ORDER;
+        header.key_size           = sizeof(Key);
+        header.value_size         = sizeof(value_type);
+        header.value_align        = alignof(value_type);
+        header.info_size          = sizeof(bucket_info);
+        header.hasher_fingerprint = details::hasher_fingerprint<Hash, Key>();
+        header.policy_fingerprint = details::type_fingerprint(typeid(GrowthPolicy));
+        header.bucket_count       = capacity;
+        header.size               = map.size();
+        header.empty_key_offset   = details::align_up(sizeof(header));
+        header.infos_offset       = details::align_up(header.empty_key_offset + sizeof(Key));
+        header.buckets_offset     = details::align_up(header.infos_offset + capacity * sizeof(bucket_info));
+        header.file_size          = header.buckets_offset + capacity * sizeof(value_type);
+
+        std::unique_ptr<std::FILE, int (*)(std::FILE*)> file(std::fopen(path.c_str(), "wb"), &std::fclose);
+        if (!file)
+        {
+            throw std::runtime_error("mapped_hash_map: cannot create " + path);
+        }
+
+        auto write = [&](const void* data, std::size_t bytes)
+        {
+            if (bytes != 0 && std::fwrite(data, 1, bytes, file.get()) != bytes)
+            {
+                throw std::runtime_error("mapped_hash_map: cannot write " + path);
+            }
+        };
+        auto pad_to = [&](std::uint64_t offset, std::uint64_t &written)
+        {
+            static constexpr const unsigned char zeros[MAPPED_ALIGNMENT] = {};
+            write(zeros, offset - written);
+            written = offset;
+        };
+
+        std::uint64_t written = sizeof(header);
+        write(&header, sizeof(header));
+        pad_to(header.empty_key_offset, written);
+        write(&map.m_empty_key, sizeof(Key));
+        written += sizeof(Key);
+        pad_to(header.infos_offset, written);
+
+        // Probe distances are written without the epoch base, empty buckets
+        // as zeros
+        std::vector<bucket_info> infos(std::min(capacity, MAPPED_WRITE_BUCKETS));
+        for (size_type first = 0; first < capacity; first += infos.size())
+        {
+            const size_type n = std::min(infos.size(), capacity - first);
+            for (size_type i = 0; i < n; ++i)
+            {
+                const info_type &info = map.m_infos[first + i];
+                infos[i] = bucket_info();
+                if (!info.empty(map.epoch_base()))
+                {
+                    infos[i].set_distance(info.distance(map.epoch_base()));
+                    if constexpr (StoreHash)
+                    {
+                        infos[i].set_hash(info.truncated_hash());
+                    }
+                }
+            }
+            write(infos.data(), n * sizeof(bucket_info));
+        }
+        written += capacity * sizeof(bucket_info);
+        pad_to(header.buckets_offset, written);
+
+        std::vector<unsigned char> buckets(std::min(capacity, MAPPED_WRITE_BUCKETS) * sizeof(value_type));
+        for (size_type first = 0; first < capacity; first += MAPPED_WRITE_BUCKETS)
+        {
+            const size_type n = std::min(MAPPED_WRITE_BUCKETS, capacity - first);
+            std::memset(buckets.data(), 0, n * sizeof(value_type));
+            for (size_type i = 0; i < n; ++i)
+            {
+                if (!map.m_infos[first + i].empty(map.epoch_base()))
+                {
+                    std::memcpy(buckets.data() + i * sizeof(value_type),
+                                static_cast<const void*>(map.m_buckets + first + i), sizeof(value_type));
+                }
+            }
+            write(buckets.data(), n * sizeof(value_type));
+        }
+
+        if (std::fclose(file.release()) != 0)
+        {
+            throw std::runtime_error("mapped_hash_map: cannot write " + path);
+        }
+    }
+
+    // Iterators
+    const_iterator begin() const noexcept
+    {
+        const_iterator it(this, 0);
+        it.advance_past_empty();
+        return it;
+    }
+
+    const_iterator cbegin() const noexcept
+    {
+        return begin();
+    }
+
+    const_iterator end() const noexcept
+    {
+        return const_iterator(this, m_capacity);
+    }
+
+    const_iterator cend() const noexcept
+    {
+        return end();
+    }
+
+    // Capacity
+    bool empty() const noexcept
+    {
+        return m_size == 0;
+    }
+
+    size_type size() const noexcept
+    {
+        return m_size;
+    }
+
+    // Lookup
+    template <typename K>
+    const mapped_type &at(const K &key) const
+    {
+        const_iterator it = find(key);
+        if (it != end())
+        {
+            return it->second;
+        }
+        throw std::out_of_range("mapped_hash_map::at");
+    }
+
+    template <typename K>
+    size_type count(const K &key) const
+    {
+        return find(key) == end() ? 0 : 1;
+    }
+
+    // Same probe as jw::hash_map::find
+    template <typename K>
+    const_iterator find(const K &key) const
+    {
+        // Moved from, no bucket to probe
+        if (m_capacity == 0)
+        {
+            return end();
+        }
+
+        const std::size_t hash = details::table_hash<Hash>(hasher()(key));
+
+        size_type     idx  = GrowthPolicy::compute_index(hash, m_capacity);
+        distance_type dist = 0;
+
+        for (; ; idx = idx + 1 < m_capacity ? idx + 1 : 0, ++dist)
+        {
+            const bucket_info &info = m_infos[idx];
+            if (info.empty() || info.distance() < dist)
+            {
+                return end();
+            }
+
+            if (info.bucket_hash_equal(hash) && key_equal()(m_buckets[idx].first, key))
+            {
+                return const_iterator(this, idx);
+            }
+        }
+    }
+
+    // Bucket interface
+    size_type bucket_count() const noexcept
+    {
+        return m_capacity;
+    }
+
+    // Observers
+    // Not on a moved from map
+    const key_type &empty_key() const noexcept
+    {
+        return *m_empty_key;
+    }
+
+    hasher hash_function() const
+    {
+        return hasher();
+    }
+
+    key_equal key_eq() const
+    {
+        return key_equal();
+    }
+
+private:
+    using distance_type = details::distance_type;
+
+    void swap(mapped_hash_map &other) noexcept
+    {
+        std::swap(static_cast<GrowthPolicy&>(*this), static_cast<GrowthPolicy&>(other));
+        std::swap(m_data, other.m_data);
+        std::swap(m_data_size, other.m_data_size);
+        std::swap(m_empty_key, other.m_empty_key);
+        std::swap(m_infos, other.m_infos);
+        std::swap(m_buckets, other.m_buckets);
+        std::swap(m_capacity, other.m_capacity);
+        std::swap(m_size, other.m_size);
+    }
+
+    void map_file(const std::string &path)
+    {
+#ifdef JW_HAVE_MMAP
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            throw std::runtime_error("mapped_hash_map: cannot open " + path);
+        }
+
+        struct stat st;
+        if (::fstat(fd, &st) != 0 || st.st_size == 0)
+        {
+            ::close(fd);
+            throw std::runtime_error("mapped_hash_map: cannot map " + path);
+        }
+
+        void* data = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED)
+        {
+            throw std::runtime_error("mapped_hash_map: cannot map " + path);
+        }
+
+        m_data      = static_cast<const unsigned char*>(data);
+        m_data_size = static_cast<std::size_t>(st.st_size);
+#else
+        std::unique_ptr<std::FILE, int (*)(std::FILE*)> file(std::fopen(path.c_str(), "rb"), &std::fclose);
+        if (!file || std::fseek(file.get(), 0, SEEK_END) != 0)
+        {
+            throw std::runtime_error("mapped_hash_map: cannot open " + path);
+        }
+
+        const long size = std::ftell(file.get());
+        std::rewind(file.get());
+        if (size <= 0)
+        {
+            throw std::runtime_error("mapped_hash_map: cannot read " + path);
+        }
+
+        // operator new aligns on alignof(std::max_align_t) only
+        unsigned char* data = static_cast<unsigned char*>(
+            ::operator new(static_cast<std::size_t>(size), std::align_val_t(MAPPED_ALIGNMENT)));
+        if (std::fread(data, 1, static_cast<std::size_t>(size), file.get()) != static_cast<std::size_t>(size))
+        {
+            ::operator delete(data, std::align_val_t(MAPPED_ALIGNMENT));
+            throw std::runtime_error("mapped_hash_map: cannot read " + path);
+        }
+
+        m_data      = data;
+        m_data_size = static_cast<std::size_t>(size);
+#endif
+    }
+
+    void unmap_file() noexcept
+    {
+        if (m_data == nullptr)
+        {
+            return;
+        }
+
+#ifdef JW_HAVE_MMAP
+        ::munmap(const_cast<unsigned char*>(m_data), m_data_size);
+#else
+        ::operator delete(const_cast<unsigned char*>(m_data), std::align_val_t(MAPPED_ALIGNMENT));
+#endif
+        m_data      = nullptr;
+        m_data_size = 0;
+    }
+
+    // Checks the header against this type and points into the mapping
+    void attach(const std::string &path)
+    {
+        details::mapped_header header;
+        if (m_data_size < sizeof(header))
+        {
+            throw std::runtime_error("mapped_hash_map: " + path + " is truncated");
+        }
+        std::memcpy(&header, m_data, sizeof(header));
+
+        if (std::memcmp(header.magic, details::MAPPED_MAGIC, sizeof(header.magic)) != 0)
+        {
+            throw std::runtime_error("mapped_hash_map: " + path + " is not a mapped_hash_map file");
+        }
+        if (header.version != MAPPED_VERSION || header.byte_order != details::MAPPED_BYTE_ORDER)
+        {
+            throw std::runtime_error("mapped_hash_map: " + path + " has another version or byte order");
+        }
+        if (header.key_size != sizeof(Key) || header.value_size != sizeof(value_type) ||
+            header.value_align != alignof(value_type) || header.info_size != sizeof(bucket_info))
+        {
+            throw std::runtime_error("mapped_hash_map: " + path + " has another bucket layout");
+        }
+        if (header.hasher_fingerprint != details::hasher_fingerprint<Hash, Key>() ||
+            header.policy_fingerprint != details::type_fingerprint(typeid(GrowthPolicy)))
+        {
+            throw std::runtime_error("mapped_hash_map: " + path + " was written with another hasher or growth policy");
+        }
+
+        // Stateful growth policies pick their state from the capacity
+        const size_type capacity = static_cast<size_type>(header.bucket_count);
+        if (capacity == 0 || header.size >= capacity ||
+            GrowthPolicy::compute_closest_capacity(capacity) != capacity)
+        {
+            throw std::runtime_error("mapped_hash_map: " + path + " has an invalid bucket count");
+        }
+
+        if (header.empty_key_offset != details::align_up(sizeof(header)) ||
+            header.infos_offset != details::align_up(header.empty_key_offset + sizeof(Key)) ||
+            header.buckets_offset != details::align_up(header.infos_offset + capacity * sizeof(bucket_info)) ||
+            header.file_size != header.buckets_offset + capacity * sizeof(value_type) ||
+            header.file_size != m_data_size)
+        {
+            throw std::runtime_error("mapped_hash_map: " + path + " is truncated");
+        }
+
+        m_empty_key = reinterpret_cast<const key_type*>(m_data + header.empty_key_offset);
+        m_infos     = reinterpret_cast<const bucket_info*>(m_data + header.infos_offset);
+        m_buckets   = reinterpret_cast<const value_type*>(m_data + header.buckets_offset);
+        m_capacity  = capacity;
+        m_size      = static_cast<size_type>(header.size);
+    }
+
+private:
+    const unsigned char* m_data      = nullptr;
+    std::size_t          m_data_size = 0;
+    const key_type*      m_empty_key = nullptr;
+    const bucket_info*   m_infos     = nullptr;
+    const value_type*    m_buckets   = nullptr;
+    size_type            m_capacity  = 0;
+    size_type            m_size      = 0;
+};
+
+}
@@ -0,0 +1,354 @@
+/**
+ * @file numa_allocator.h
+ * @author jian wu (jian.wu_93@foxmail.com)
+ * @brief Allocator placing big allocations (bucket arrays) on a NUMA node,
+ * plus the node queries the NUMA aware maps need.
+ *
+ * Allocations of at least ALLOC_NUMA_THRESHOLD bytes are mapped with mmap
+ * and bound to the node of the allocator with mbind(MPOL_PREFERRED) before
+ * anything touches them, so the pages come from that node whichever thread
+ * fills the table, and from the other nodes once it is out of memory.
+ * Smaller allocations go to std::allocator. They, and every allocation of
+ * numa_allocator(NO_NUMA_NODE), are placed by first touch.
+ *
+ * numa_allocator::on_node(node) returns the allocator bound to node:
+ * jw::sharded_hash_map and jw::replicated_hash_map use it to place their
+ * shards and replicas, jw::count::count_allocator forwards it to its
+ * upstream allocator.
+ *
+ * The nodes are read from /sys/devices/system/node and the system calls are
+ * made directly, libnuma is not needed. Other platforms than Linux see a
+ * single node and numa_allocator is std::allocator.
+ *
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define JW_HAVE_NUMA 1
+#endif
+
+namespace jw
+{
+
+static constexpr const int NO_NUMA_NODE = -1;
+
+// Highest node count the node masks given to the kernel can hold
+static constexpr const int MAX_NUMA_NODES = 1024;
+
+namespace details
+{
+
+// Parses a sysfs list such as "0-3,8-11"
+inline std::vector<int> parse_node_list(const std::string &list)
+{
+    std::vector<int> res;
+    std::size_t pos = 0;
+    while (pos < list.size())
+    {
+        std::size_t next = list.find(',', pos);
+        if (next == std::string::npos)
+        {
+            next = list.size();
+        }
+
+        const std::string range = list.substr(pos, next - pos);
+        const std::size_t dash  = range.find('-');
+        try
+        {
+            const int first = std::stoi(range.substr(0, dash));
+            const int last  = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int i = first; i <= last; ++i)
+            {
+                res.push_back(i);
+            }
+        }
+        catch (const std::exception&)
+        {
+            // Trailing newline or empty list
+        }
+        pos = next + 1;
+    }
+    return res;
+}
+
+inline std::string read_sysfs(const std::string &path)
+{
+    std::ifstream in(path);
+    std::string line;
+    std::getline(in, line);
+    return line;
+}
+
+// Node of every cpu, read once
+struct numa_topology
+{
+    int              m_nodes = 1;
+    std::vector<int> m_cpuNodes;
+
+    numa_topology()
+    {
+#ifdef JW_HAVE_NUMA
+        const std::vector<int> online = parse_node_list(read_sysfs("/sys/devices/system/node/online"));
+        if (online.empty())
+        {
+            return;
+        }
+
+        m_nodes = std::min(online.back() + 1, MAX_NUMA_NODES);
+        for (int node : online)
+        {
+            const std::string cpus = read_sysfs("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            for (int cpu : parse_node_list(cpus))
+            {
+                if (cpu >= static_cast<int>(m_cpuNodes.size()))
+                {
+                    m_cpuNodes.resize(cpu + 1, 0);
+                }
+                m_cpuNodes[cpu] = node;
+            }
+        }
+#endif
+    }
+
+    static const numa_topology& instance()
+    {
+        static const numa_topology topology;
+        return topology;
+    }
+};
+
+}
+
+// Number of NUMA nodes (highest online node plus one), 1 without NUMA
+inline int numa_node_count()
+{
+    return details::numa_topology::instance().m_nodes;
+}
+
+// Node of the cpu the calling thread runs on, 0 when unknown. The thread may
+// be moved right after unless it is bound with numa_bind_thread()
+inline int numa_current_node()
+{
+#ifdef JW_HAVE_NUMA
+    const std::vector<int>& cpu_nodes = details::numa_topology::instance().m_cpuNodes;
+    const int cpu = ::sched_getcpu();
+    if (cpu >= 0 && cpu < static_cast<int>(cpu_nodes.size()))
+    {
+        return cpu_nodes[cpu];
+    }
+#endif
+    return 0;
+}
+
+// Restricts the calling thread to the cpus of node, returns false if the
+// node has no cpu or the affinity could not be set
+inline bool numa_bind_thread(int node)
+{
+#ifdef JW_HAVE_NUMA
+    const std::vector<int>& cpu_nodes = details::numa_topology::instance().m_cpuNodes;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    bool any = false;
+    for (int cpu = 0; cpu < static_cast<int>(cpu_nodes.size()) && cpu < CPU_SETSIZE; ++cpu)
+    {
+        if (cpu_nodes[cpu] == node)
+        {
+            CPU_SET(cpu, &set);
+            any = true;
+        }
+    }
+    return any && ::sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    return node == 0;
+#endif
+}
+
+// Prefers node for the pages of [p, p + bytes) not touched yet, p page aligned
+inline bool numa_bind_memory(void* p, std::size_t bytes, int node) noexcept
+{
+#ifdef JW_HAVE_NUMA
+    if (node < 0 || node >= MAX_NUMA_NODES)
+    {
+        return false;
+    }
+
+    constexpr const int MPOL_PREFERRED_MODE = 1;
+    constexpr const int MASK_BITS           = 8 * sizeof(unsigned long);
+
+    unsigned long mask[MAX_NUMA_NODES / MASK_BITS] = {};
+    mask[node / MASK_BITS] = 1ul << (node % MASK_BITS);
+
+    // The kernel reads maxnode - 1 bits
+    return ::syscall(SYS_mbind, p, bytes, MPOL_PREFERRED_MODE, mask, MAX_NUMA_NODES + 1, 0) == 0;
+#else
+    (void)p;
+    (void)bytes;
+    return node == 0;
+#endif
+}
+
+// Node holding the page of p, NO_NUMA_NODE if it is not backed yet or unknown
+inline int numa_node_of(const void* p) noexcept
+{
+#ifdef JW_HAVE_NUMA
+    const std::uintptr_t page_size = static_cast<std::uintptr_t>(::sysconf(_SC_PAGESIZE));
+    void* page   = reinterpret_cast<void*>(reinterpret_cast<std::uintptr_t>(p) & ~(page_size - 1));
+    int   status = NO_NUMA_NODE;
+    if (::syscall(SYS_move_pages, 0, 1, &page, nullptr, &status, 0) == 0 && status >= 0)
+    {
+        return status;
+    }
+    return NO_NUMA_NODE;
+#else
+    (void)p;
+    return 0;
+#endif
+}
+
+template <typename T>
+class numa_allocator
+{
+public:
+    constexpr static std::size_t ALLOC_NUMA_THRESHOLD = 1 << 16; // 64KB
+
+    using value_type = T;
+
+    // The node follows the buckets, a table keeps growing on its node
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap            = std::true_type;
+
+    numa_allocator() = default;
+
+    explicit numa_allocator(int node) noexcept : m_node(node)
+    { }
+
+    template <class U>
+    constexpr numa_allocator(const numa_allocator<U> &other) noexcept : m_node(other.node())
+    { }
+
+    numa_allocator(const numa_allocator&) = default;
+
+    // Either allocator frees the memory of the other, the node only places
+    // new allocations
+    friend bool operator==(const numa_allocator&, const numa_allocator&)
+    {
+        return true;
+    }
+
+    friend bool operator!=(const numa_allocator&, const numa_allocator&)
+    {
+        return false;
+    }
+
+    numa_allocator on_node(int node) const noexcept
+    {
+        return numa_allocator(node);
+    }
+
+    int node() const noexcept
+    {
+        return m_node;
+    }
+
+    value_type* allocate(std::size_t n)
+    {
+        const std::size_t bytes = n * sizeof(value_type);
+#ifdef JW_HAVE_NUMA
+        if (bytes >= ALLOC_NUMA_THRESHOLD)
+        {
+            void* p = ::mmap(nullptr, mapped_size(bytes), PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p == MAP_FAILED)
+            {
+                throw std::bad_alloc();
+            }
+
+            // Memory the kernel did not bind is still usable
+            if (m_node != NO_NUMA_NODE)
+            {
+                numa_bind_memory(p, mapped_size(bytes), m_node);
+            }
+            return static_cast<value_type*>(p);
+        }
+#endif
+        (void)bytes;
+        return std::allocator<value_type>().allocate(n);
+    }
+
+    void deallocate(T* p, std::size_t n)
+    {
+        const std::size_t bytes = n * sizeof(value_type);
+#ifdef JW_HAVE_NUMA
+        if (bytes >= ALLOC_NUMA_THRESHOLD)
+        {
+            ::munmap(p, mapped_size(bytes));
+            return;
+        }
+#endif
+        (void)bytes;
+        std::allocator<value_type>().deallocate(p, n);
+    }
+
+private:
+#ifdef JW_HAVE_NUMA
+    static std::size_t mapped_size(std::size_t bytes) noexcept
+    {
+        const std::size_t page_size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        return (bytes + page_size - 1) & ~(page_size - 1);
+    }
+#endif
+
+    int m_node = NO_NUMA_NODE;
+};
+
+namespace details
+{
+
+template <typename Allocator, typename = void>
+struct has_on_node : std::false_type
+{ };
+
+template <typename Allocator>
+struct has_on_node<Allocator, std::void_t<decltype(std::declval<const Allocator&>().on_node(0))>>
+    : std::true_type
+{ };
+
+// alloc bound to node when it places memory, alloc itself otherwise
+template <typename Allocator>
+Allocator allocator_on_node(const Allocator &alloc, int node)
+{
+    if constexpr (has_on_node<Allocator>::value)
+    {
+        return alloc.on_node(node);
+    }
+    else
+    {
+        (void)node;
+        return alloc;
+    }
+}
+
+}
+}
@@ -2,6 +2,16 @@
  * @file power_of_two_growth_policy.h
  * @author jian wu (jian.wu_93@foxmail.com)
  * @brief Grow policy(power of 2)
+ * 
+ * A growth policy provides:
+ * - compute_index(hash, capacity): maps a hash to a bucket in [0, capacity)
+ * - compute_closest_capacity(min_capacity): the capacity used for at least
+ *   min_capacity buckets. Only the table which will own those buckets calls
+ *   it, so a stateful policy may record the capacity.
+ * - compute_next_capacity(capacity): the capacity to grow to, i.e. the growth
+ *   factor of the table
+ * - minimum_capacity(): the smallest capacity
+ * 
  * @version 0.1
  * @date 2024-02-16
  * 
@@ -16,8 +26,21 @@
 namespace jw::details
 {
 
+/**
+ * @brief Capacity is a power of 2, the index is the low bits of the hash.
+ * Fastest policy, requires a hasher which mixes the low bits properly.
+ * 
+ * @tparam GrowthFactor power of 2 the capacity is multiplied by on growth
+ */
+template <std::size_t GrowthFactor = 2>
 struct power_of_two_growth_policy
 {
+    static_assert(GrowthFactor >= 2 && (GrowthFactor & (GrowthFactor - 1)) == 0,
+                  "GrowthFactor must be a power of two");
+
+    // Only the low bits of the hash take part in the index
+    static constexpr bool INDEX_FROM_LOW_BITS = true;
+
     static std::size_t compute_index(std::size_t hash, std::size_t capacity)
     {
         return hash & (capacity - 1);
@@ -44,6 +67,11 @@ struct power_of_two_growth_policy
         return ++min_capacity;
     }
 
+    static std::size_t compute_next_capacity(std::size_t capacity)
+    {
+        return capacity * GrowthFactor;
+    }
+
     static std::size_t minimum_capacity() 
     { 
         return 8u; 
@@ -0,0 +1,136 @@
+/**
+ * @file prime_growth_policy.h
+ * @author jian wu (jian.wu_93@foxmail.com)
+ * @brief Grow policy(prime capacity)
+ * 
+ * The capacity is a prime and the index is hash % capacity, every bit of the
+ * hash takes part in the index, so weak hashers (identity, CRC of sequential
+ * keys) still spread over the table. The primes are compile time constants,
+ * each one has its own modulo function so the compiler replaces the division
+ * by a multiplication. The policy keeps the position of the current prime.
+ * 
+ * @version 0.1
+ * @date 2026-10-14
+ * 
+ * 
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace jw::details
+{
+
+// Primes growing by ~1.25x from 11 to near 2^63
+static constexpr const std::uint64_t PRIMES[] = {
+    11ull, 13ull, 17ull, 23ull, 29ull, 37ull, 47ull, 59ull, 73ull, 97ull, 127ull,
+    163ull, 211ull, 263ull, 331ull, 419ull, 523ull, 653ull, 821ull, 1031ull, 1289ull,
+    1613ull, 2017ull, 2521ull, 3163ull, 3967ull, 4967ull, 6211ull, 7789ull, 9739ull,
+    12197ull, 15259ull, 19073ull, 23857ull, 29833ull, 37307ull, 46633ull, 58309ull,
+    72889ull, 91121ull, 113903ull, 142381ull, 177979ull, 222493ull, 278119ull,
+    347651ull, 434563ull, 543203ull, 679033ull, 848791ull, 1060991ull, 1326239ull,
+    1657801ull, 2072267ull, 2590349ull, 3237947ull, 4047469ull, 5059363ull, 6324203ull,
+    7905253ull, 9881569ull, 12351967ull, 15439979ull, 19299979ull, 24124993ull,
+    30156241ull, 37695311ull, 47119141ull, 58898951ull, 73623691ull, 92029621ull,
+    115037047ull, 143796311ull, 179745407ull, 224681759ull, 280852199ull, 351065257ull,
+    438831571ull, 548539469ull, 685674359ull, 857092967ull, 1071366209ull,
+    1339207777ull, 1674009767ull, 2092512209ull, 2615640277ull, 3269550391ull,
+    4086937993ull, 5108672507ull, 6385840639ull, 7982300813ull, 9977876017ull,
+    12472345037ull, 15590431313ull, 19488039161ull, 24360048967ull, 30450061249ull,
+    38062576577ull, 47578220731ull, 59472775913ull, 74340969953ull, 92926212451ull,
+    116157765599ull, 145197207007ull, 181496508773ull, 226870635967ull,
+    283588294963ull, 354485368703ull, 443106710899ull, 553883388679ull,
+    692354235919ull, 865442794939ull, 1081803493711ull, 1352254367159ull,
+    1690317958949ull, 2112897448693ull, 2641121810879ull, 3301402263611ull,
+    4126752829559ull, 5158441037011ull, 6448051296293ull, 8060064120371ull,
+    10075080150493ull, 12593850188141ull, 15742312735187ull, 19677890918989ull,
+    24597363648743ull, 30746704560967ull, 38433380701211ull, 48041725876559ull,
+    60052157345717ull, 75065196682181ull, 93831495852793ull, 117289369815997ull,
+    146611712270057ull, 183264640337587ull, 229080800422013ull, 286351000527533ull,
+    357938750659471ull, 447423438324361ull, 559279297905491ull, 699099122381909ull,
+    873873902977423ull, 1092342378721813ull, 1365427973402279ull, 1706784966752893ull,
+    2133481208441117ull, 2666851510551407ull, 3333564388189279ull, 4166955485236681ull,
+    5208694356545861ull, 6510867945682351ull, 8138584932102997ull,
+    10173231165128767ull, 12716538956410987ull, 15895673695513783ull,
+    19869592119392233ull, 24836990149240319ull, 31046237686550407ull,
+    38807797108188019ull, 48509746385235071ull, 60637182981543877ull,
+    75796478726929871ull, 94745598408662339ull, 118431998010827929ull,
+    148039997513534923ull, 185049996891918671ull, 231312496114898333ull,
+    289140620143622987ull, 361425775179528721ull, 451782218974410887ull,
+    564727773718013611ull, 705909717147517067ull, 882387146434396381ull,
+    1102983933042995467ull, 1378729916303744353ull, 1723412395379680289ull,
+    2154265494224600399ull, 2692831867780750469ull, 3366039834725938247ull,
+    4207549793407422491ull, 5259437241759278087ull, 6574296552199097411ull,
+    8217870690248871941ull
+};
+
+static constexpr const std::size_t PRIMES_COUNT = sizeof(PRIMES) / sizeof(PRIMES[0]);
+
+template <std::size_t I>
+std::size_t mod_prime(std::size_t hash)
+{
+    return hash % PRIMES[I];
+}
+
+template <std::size_t... I>
+constexpr std::array<std::size_t (*)(std::size_t), sizeof...(I)>
+make_mod_primes(std::index_sequence<I...>)
+{
+    return {{&mod_prime<I>...}};
+}
+
+static constexpr const std::array<std::size_t (*)(std::size_t), PRIMES_COUNT> MOD_PRIMES =
+    make_mod_primes(std::make_index_sequence<PRIMES_COUNT>());
+
+/**
+ * @tparam GrowthNum, GrowthDen growth factor GrowthNum / GrowthDen, 3 / 2 by
+ * default
+ */
+template <std::size_t GrowthNum = 3, std::size_t GrowthDen = 2>
+class prime_growth_policy
+{
+public:
+    static_assert(GrowthNum > GrowthDen && GrowthDen > 0, "growth factor must be > 1");
+
+    std::size_t compute_index(std::size_t hash, std::size_t capacity) const
+    {
+        assert(capacity == PRIMES[m_iprime]);
+        (void)capacity;
+
+        return MOD_PRIMES[m_iprime](hash);
+    }
+
+    std::size_t compute_closest_capacity(std::size_t min_capacity)
+    {
+        const std::uint64_t* prime = std::lower_bound(PRIMES, PRIMES + PRIMES_COUNT, min_capacity);
+
+        if (prime == PRIMES + PRIMES_COUNT)
+        {
+            assert(false && "Maximum capacity for the prime_growth_policy reached.");
+            --prime;
+        }
+
+        m_iprime = static_cast<std::size_t>(prime - PRIMES);
+        return static_cast<std::size_t>(*prime);
+    }
+
+    static std::size_t compute_next_capacity(std::size_t capacity)
+    {
+        return capacity / GrowthDen * GrowthNum + 1;
+    }
+
+    static std::size_t minimum_capacity()
+    {
+        return static_cast<std::size_t>(PRIMES[0]);
+    }
+
+private:
+    std::size_t m_iprime = 0;
+};
+
+}
@@ -0,0 +1,377 @@
+/**
+ * @file replicated_hash_map.h
+ * @author jian wu (jian.wu_93@foxmail.com)
+ * @brief Thread safe read-mostly map keeping one jw::hash_map per NUMA node.
+ *
+ * Every replica holds all the keys and is allocated on its own node (through
+ * numa_allocator::on_node, see jw/numa_allocator.h). Lookups read the replica
+ * of the node the calling thread runs on, so a read never crosses the
+ * interconnect; writes are applied to every replica, with all their locks
+ * held, so no reader sees two replicas disagree.
+ *
+ * The replica is picked from sched_getcpu() on every lookup, threads bound to
+ * a node (numa_bind_thread()) always read the same one. find_on() and
+ * visit_on() read a given replica.
+ *
+ * A write costs one insert per node: use jw::sharded_hash_map for write
+ * heavy maps. A write which throws leaves every replica as it was: an insert
+ * erases the key from the replicas it already reached, an assignment makes
+ * its copies before touching any replica. When mapped_type may throw on
+ * move, an assignment copies the old value back instead, and the replicas
+ * only disagree if that copy throws as well.
+ *
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "hash_map.h"
+#include "numa_allocator.h"
+#include "sharded_hash_map.h"
+
+namespace jw
+{
+
+template <typename Key,
+          typename T,
+          typename Hash         = std::hash<Key>,
+          typename KeyEqual     = std::equal_to<void>,
+          typename Allocator    = numa_allocator<std::pair<Key, T>>,
+          typename Mutex        = std::shared_mutex,
+          typename GrowthPolicy = details::power_of_two_growth_policy<>,
+          bool StoreHash        = false>
+class replicated_hash_map
+{
+public:
+    using map_type       = hash_map<Key, T, Hash, KeyEqual, Allocator, GrowthPolicy, StoreHash>;
+    using key_type       = typename map_type::key_type;
+    using mapped_type    = typename map_type::mapped_type;
+    using value_type     = typename map_type::value_type;
+    using size_type      = typename map_type::size_type;
+    using hasher         = typename map_type::hasher;
+    using key_equal      = typename map_type::key_equal;
+    using allocator_type = typename map_type::allocator_type;
+    using mutex_type     = Mutex;
+
+private:
+    using read_lock  = details::read_lock<mutex_type>;
+    using write_lock = std::unique_lock<mutex_type>;
+
+    // Built in place with its allocator, as the shards of jw::sharded_hash_map
+    struct alignas(CACHE_LINE_SIZE) replica
+    {
+        replica(size_type bucket_count, const key_type &empty_key, const allocator_type &alloc, int node)
+            : m_map(bucket_count, empty_key, alloc), m_node(node)
+        { }
+
+        mutable mutex_type m_mutex;
+        map_type           m_map;
+        int                m_node;
+    };
+
+public:
+    replicated_hash_map() : replicated_hash_map(0)
+    { }
+
+    /**
+     * @param bucket_count initial bucket count of every replica
+     * @param replica_count one per node by default, replica i is on node
+     * i % numa_node_count()
+     */
+    explicit replicated_hash_map(size_type bucket_count,
+                                 key_type empty_key = key_type(),
+                                 const allocator_type &alloc = allocator_type(),
+                                 size_type replica_count = static_cast<size_type>(numa_node_count()))
+        : m_replica_count(std::max<size_type>(replica_count, 1)),
+          m_replicas(m_replica_count, [&](size_type i)
+          {
+              const int node = static_cast<int>(i % numa_node_count());
+              return replica(std::max(bucket_count, GrowthPolicy::minimum_capacity()), empty_key,
+                             details::allocator_on_node(alloc, node), node);
+          })
+    { }
+
+    replicated_hash_map(const replicated_hash_map&)            = delete;
+    replicated_hash_map& operator=(const replicated_hash_map&) = delete;
+
+    // Capacity
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    size_type size() const
+    {
+        const replica& r = local();
+        read_lock lock(r.m_mutex);
+        return r.m_map.size();
+    }
+
+    size_type replica_count() const noexcept
+    {
+        return m_replica_count;
+    }
+
+    // Modifiers
+    void clear()
+    {
+        auto locks = lock_all();
+        for (size_type i = 0; i < m_replica_count; ++i)
+        {
+            m_replicas[i].m_map.clear();
+        }
+    }
+
+    // Returns true if the value was inserted
+    bool insert(const value_type &value)
+    {
+        return emplace(value.first, value.second);
+    }
+
+    template <typename... Args>
+    bool emplace(const key_type &key, Args &&... args)
+    {
+        // Every replica copies the same value, built once
+        const mapped_type obj(std::forward<Args>(args)...);
+
+        auto locks = lock_all();
+        if (m_replicas[0].m_map.count(key) != 0)
+        {
+            return false;
+        }
+        insert_all(key, obj);
+        return true;
+    }
+
+    // Returns true if the value was inserted, false if it was assigned
+    template <typename M>
+    bool insert_or_assign(const key_type &key, M &&obj)
+    {
+        auto locks = lock_all();
+        if (m_replicas[0].m_map.count(key) == 0)
+        {
+            insert_all(key, std::as_const(obj));
+            return true;
+        }
+        assign_all(key, std::as_const(obj));
+        return false;
+    }
+
+    template <typename K>
+    size_type erase(const K &key)
+    {
+        auto locks = lock_all();
+        size_type erased = 0;
+        for (size_type i = 0; i < m_replica_count; ++i)
+        {
+            erased = m_replicas[i].m_map.erase(key);
+        }
+        return erased;
+    }
+
+    // Lookup, in the replica of the calling thread's node
+    template <typename K>
+    std::optional<mapped_type> find(const K &key) const
+    {
+        return find_on(local_replica(), key);
+    }
+
+    template <typename K>
+    std::optional<mapped_type> find_on(size_type replica_index, const K &key) const
+    {
+        const replica& r = m_replicas[replica_index];
+        read_lock lock(r.m_mutex);
+
+        auto it = r.m_map.find(key);
+        if (it == r.m_map.end())
+        {
+            return std::nullopt;
+        }
+        return it->second;
+    }
+
+    template <typename K>
+    size_type count(const K &key) const
+    {
+        const replica& r = local();
+        read_lock lock(r.m_mutex);
+        return r.m_map.count(key);
+    }
+
+    // Calls fn(const mapped_type&) with the local replica locked, returns
+    // false if key is not in the map
+    template <typename K, typename F>
+    bool visit(const K &key, F &&fn) const
+    {
+        return visit_on(local_replica(), key, std::forward<F>(fn));
+    }
+
+    template <typename K, typename F>
+    bool visit_on(size_type replica_index, const K &key, F &&fn) const
+    {
+        const replica& r = m_replicas[replica_index];
+        read_lock lock(r.m_mutex);
+
+        auto it = r.m_map.find(key);
+        if (it == r.m_map.end())
+        {
+            return false;
+        }
+        fn(static_cast<const mapped_type&>(it->second));
+        return true;
+    }
+
+    // Calls fn(const value_type&) for every element of the local replica
+    template <typename F>
+    void visit_all(F &&fn) const
+    {
+        const replica& r = local();
+        read_lock lock(r.m_mutex);
+        for (const auto& value : r.m_map)
+        {
+            fn(value);
+        }
+    }
+
+    // Hash policy
+    void reserve(size_type count)
+    {
+        auto locks = lock_all();
+        for (size_type i = 0; i < m_replica_count; ++i)
+        {
+            m_replicas[i].m_map.reserve(count);
+        }
+    }
+
+    void max_load_factor(float ml)
+    {
+        auto locks = lock_all();
+        for (size_type i = 0; i < m_replica_count; ++i)
+        {
+            m_replicas[i].m_map.max_load_factor(ml);
+        }
+    }
+
+    // Observers
+    hasher hash_function() const
+    {
+        return hasher();
+    }
+
+    key_equal key_eq() const
+    {
+        return key_equal();
+    }
+
+    // Replica read by the calling thread
+    size_type local_replica() const
+    {
+        return static_cast<size_type>(numa_current_node()) % m_replica_count;
+    }
+
+    // NUMA node replica_index is allocated on
+    int replica_node(size_type replica_index) const noexcept
+    {
+        return m_replicas[replica_index].m_node;
+    }
+
+private:
+    const replica& local() const
+    {
+        return m_replicas[local_replica()];
+    }
+
+    // Writers lock the replicas in index order
+    std::vector<write_lock> lock_all()
+    {
+        std::vector<write_lock> locks;
+        locks.reserve(m_replica_count);
+        for (size_type i = 0; i < m_replica_count; ++i)
+        {
+            locks.emplace_back(m_replicas[i].m_mutex);
+        }
+        return locks;
+    }
+
+    // The replicas hold the same keys: key is in none of them. If a replica
+    // throws, key is erased from the replicas it was inserted in
+    template <typename V>
+    void insert_all(const key_type &key, const V &obj)
+    {
+        size_type i = 0;
+        try
+        {
+            for (; i < m_replica_count; ++i)
+            {
+                m_replicas[i].m_map.emplace(key, obj);
+            }
+        }
+        catch (...)
+        {
+            for (size_type j = 0; j < i; ++j)
+            {
+                m_replicas[j].m_map.erase(key);
+            }
+            throw;
+        }
+    }
+
+    // key is in every replica
+    template <typename V>
+    void assign_all(const key_type &key, const V &obj)
+    {
+        if constexpr (std::is_nothrow_move_assignable_v<mapped_type>)
+        {
+            // Only the copies may throw, before any replica changes
+            std::vector<mapped_type> values;
+            values.reserve(m_replica_count);
+            for (size_type i = 0; i < m_replica_count; ++i)
+            {
+                values.emplace_back(obj);
+            }
+            for (size_type i = 0; i < m_replica_count; ++i)
+            {
+                m_replicas[i].m_map.find(key)->second = std::move(values[i]);
+            }
+        }
+        else
+        {
+            const mapped_type old(m_replicas[0].m_map.find(key)->second);
+            size_type i = 0;
+            try
+            {
+                for (; i < m_replica_count; ++i)
+                {
+                    m_replicas[i].m_map.find(key)->second = obj;
+                }
+            }
+            catch (...)
+            {
+                // Replica i may be left half assigned as well
+                for (size_type j = 0; j <= i && j < m_replica_count; ++j)
+                {
+                    m_replicas[j].m_map.find(key)->second = old;
+                }
+                throw;
+            }
+        }
+    }
+
+private:
+    size_type                     m_replica_count;
+    details::fixed_array<replica> m_replicas;
+};
+}
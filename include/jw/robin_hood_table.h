@@ -0,0 +1,1834 @@
+/**
+ * @file robin_hood_table.h
+ * @author jian wu (jian.wu_93@foxmail.com)
+ * @brief Robin Hood open addressing table shared by jw::hash_map and
+ * jw::hash_set: linear probing, growth, backward shift erase, batches, clear
+ * and stats. See hash_map.h for the design.
+ *
+ * details::robin_hood_table<Key, T, ...> stores std::pair<Key, T>, or the
+ * keys alone when T is void. The operations on mapped values (at,
+ * operator[], try_emplace, insert_or_assign) belong to jw::hash_map.
+ *
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "hash.h"
+#include "power_of_two_growth_policy.h"
+
+namespace jw 
+{
+
+template <typename Key, typename T, typename Hash, typename KeyEqual,
+          typename Allocator, typename GrowthPolicy, bool StoreHash>
+class incremental_hash_map;
+
+template <typename Key, typename T, typename Hash, typename KeyEqual,
+          typename GrowthPolicy, bool StoreHash>
+class mapped_hash_map;
+
+static constexpr const float DEFAULT_MAX_LOAD_FACTOR = 0.800f;
+static constexpr const std::size_t BATCH_PREFETCH = 16;
+static constexpr const float MINIMUM_MAX_LOAD_FACTOR = 0.100f;
+static constexpr const float MAXIMUM_MAX_LOAD_FACTOR = 0.950f;
+static constexpr const float DEFAULT_MIN_LOAD_FACTOR = 0.000f;
+static constexpr const std::size_t CACHE_LINE_SIZE = 64;
+
+namespace details
+{
+
+using distance_type       = std::uint16_t;
+using truncated_hash_type = std::uint32_t;
+
+// Probe distances from this value on make the map grow on the next insert
+static constexpr const distance_type DIST_LIMIT = 4096;
+
+// Longest probe distance a bucket records, inserts needing a longer one
+// throw std::length_error
+static constexpr const distance_type MAX_DISTANCE = std::numeric_limits<distance_type>::max() - 1;
+
+// Long probes are blamed on the hasher below this load, growing wouldn't help
+static constexpr const float MIN_LOAD_FACTOR_FOR_GROWTH = 0.15f;
+
+/**
+ * @brief Hash stored in the bucket metadata, empty unless StoreHash
+ */
+template <bool StoreHash>
+struct bucket_hash
+{
+    static constexpr bool bucket_hash_equal(std::size_t) noexcept
+    {
+        return true;
+    }
+
+    truncated_hash_type truncated_hash() const noexcept
+    {
+        assert(false && "hash is not stored");
+        return 0;
+    }
+
+    void set_hash(std::size_t) noexcept
+    { }
+};
+
+template <>
+struct bucket_hash<true>
+{
+    bool bucket_hash_equal(std::size_t hash) const noexcept
+    {
+        return m_hash == static_cast<truncated_hash_type>(hash);
+    }
+
+    truncated_hash_type truncated_hash() const noexcept
+    {
+        return m_hash;
+    }
+
+    void set_hash(std::size_t hash) noexcept
+    {
+        m_hash = static_cast<truncated_hash_type>(hash);
+    }
+
+    truncated_hash_type m_hash = 0;
+};
+
+/**
+ * @brief Per bucket metadata, kept apart from the buckets so probing only
+ * reads the key of buckets it may have to compare.
+ *
+ * With EpochClear the probe distance is stored above the epoch base of the
+ * table (a multiple of EPOCH_STRIDE): buckets written before the base was
+ * last raised read as empty.
+ */
+template <bool StoreHash, bool EpochClear = false>
+struct bucket_info : bucket_hash<StoreHash>
+{
+    using tag_type = std::conditional_t<EpochClear, std::uint32_t, distance_type>;
+
+    static constexpr const tag_type EPOCH_STRIDE = EpochClear ? tag_type(1) << 16 : 0;
+
+    bool empty(tag_type base = 0) const noexcept
+    {
+        return m_dist <= base;
+    }
+
+    // Distance of the bucket from the ideal slot of its key
+    distance_type distance(tag_type base = 0) const noexcept
+    {
+        return static_cast<distance_type>(m_dist - base - 1);
+    }
+
+    void set_distance(distance_type dist, tag_type base = 0) noexcept
+    {
+        assert(dist <= MAX_DISTANCE && "probe distance overflow");
+        m_dist = static_cast<tag_type>(base + dist + 1);
+    }
+
+    void clear() noexcept
+    {
+        m_dist = 0;
+    }
+
+    // Epoch base plus probe distance plus one, up to the base marks an empty bucket
+    tag_type m_dist = 0;
+};
+
+inline void prefetch(const void* addr) noexcept
+{
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(addr);
+#else
+    (void)addr;
+#endif
+}
+
+// Policies declaring INDEX_FROM_LOW_BITS compute the index from the low bits
+// of the hash only, so a truncated hash gives the same index
+template <typename GrowthPolicy, typename = void>
+struct index_from_low_bits : std::false_type
+{ };
+
+template <typename GrowthPolicy>
+struct index_from_low_bits<GrowthPolicy, std::void_t<decltype(GrowthPolicy::INDEX_FROM_LOW_BITS)>>
+    : std::bool_constant<GrowthPolicy::INDEX_FROM_LOW_BITS>
+{ };
+
+}
+
+/**
+ * @brief Snapshot of the shape of a hash_map and of its counters.
+ *
+ * Displacement is the distance of a bucket from the home slot of its key, a
+ * cluster is a run of occupied buckets. The find, rehash and erase counters
+ * stay 0 unless JW_HASH_MAP_STATS is defined.
+ */
+struct hash_map_stats
+{
+    static constexpr const std::size_t PROBE_BUCKETS   = 32;
+    static constexpr const std::size_t CLUSTER_BUCKETS = 64;
+
+    std::size_t size         = 0;
+    std::size_t bucket_count = 0;
+
+    double      mean_displacement = 0;
+    std::size_t max_displacement  = 0;
+
+    // clusters[i] counts the clusters of [2^i, 2^(i+1)) buckets
+    std::array<std::uint64_t, CLUSTER_BUCKETS> clusters{};
+    std::size_t                                max_cluster = 0;
+
+    // find_probes[i] counts the lookups which stopped i buckets past the home
+    // slot, the last one counts the longer ones too
+    std::array<std::uint64_t, PROBE_BUCKETS> find_probes{};
+    std::uint64_t                            finds = 0;
+
+    std::uint64_t rehashes           = 0;
+    std::int64_t  rehash_nanoseconds = 0;
+
+    // Buckets moved back by the backward shift of erases
+    std::uint64_t erases       = 0;
+    std::uint64_t erase_shifts = 0;
+};
+
+/**
+ * @brief Transparent hasher of std::string keys: std::string_view and
+ * const char* are hashed as they are, without building a std::string.
+ * Hashes equal std::hash<std::string> of the same characters.
+ */
+struct string_hash
+{
+    using is_transparent = void;
+
+    std::size_t operator()(std::string_view str) const noexcept
+    {
+        return std::hash<std::string_view>()(str);
+    }
+};
+
+/**
+ * @brief Tag of the bulk build constructors: the caller guarantees the range
+ * holds no key twice, so the build skips the duplicate checks.
+ */
+struct unique_keys_t
+{
+    explicit unique_keys_t() = default;
+};
+
+inline constexpr unique_keys_t unique_keys{};
+
+namespace details
+{
+
+/**
+ * @brief Robin Hood table behind jw::hash_map (value_type std::pair<Key, T>)
+ * and jw::hash_set (T void, value_type Key): probing, growth, erase shift,
+ * batches and stats. The derived classes add the operations on mapped values
+ * and pick the defaults of the template parameters.
+ */
+template <typename Key, 
+          typename T, 
+          typename Hash,
+          typename KeyEqual,
+          typename Allocator,
+          typename GrowthPolicy,
+          bool StoreHash,
+          bool EpochClear>
+class robin_hood_table : private GrowthPolicy
+{
+    using GrowthPolicy::compute_index;
+    using GrowthPolicy::compute_closest_capacity;
+    using GrowthPolicy::compute_next_capacity;
+    using GrowthPolicy::minimum_capacity;
+
+    static constexpr const bool IS_SET = std::is_void<T>::value;
+
+    // Empty buckets are told apart by their bucket_info, the empty key is
+    // only checked against in debug builds. Integral and enum keys don't
+    // reserve one, every value of theirs is a valid key
+    static constexpr const bool RESERVES_EMPTY_KEY = !std::is_integral<Key>::value && !std::is_enum<Key>::value;
+
+public:
+    using key_type        = Key;
+    using value_type      = std::conditional_t<IS_SET, Key, std::pair<Key, T>>;
+    using size_type       = std::size_t;
+    using hasher          = Hash;
+    using key_equal       = KeyEqual;
+    using allocator_type  = Allocator;
+    using reference       = value_type &;
+    using const_reference = const value_type &;
+    using alloc_traits    = std::allocator_traits<allocator_type>;
+    using distance_type   = details::distance_type;
+    using bucket_info     = details::bucket_info<StoreHash, EpochClear>;
+    using tag_type        = typename bucket_info::tag_type;
+    using info_allocator  = typename alloc_traits::template rebind_alloc<bucket_info>;
+    using info_traits     = std::allocator_traits<info_allocator>;
+
+    // Highest base leaving room for the probe distances above it
+    static constexpr const tag_type MAX_EPOCH_BASE =
+        EpochClear ? std::numeric_limits<tag_type>::max() - (bucket_info::EPOCH_STRIDE - 1) : 0;
+
+    static_assert(!EpochClear || std::is_trivially_destructible<value_type>::value,
+                  "EpochClear leaves the values of stale buckets undestroyed");
+
+    template <typename ContT, typename IterVal> 
+    struct hash_map_iterator 
+    {
+        using difference_type   = std::ptrdiff_t;
+        using value_type        = IterVal;
+        using pointer           = value_type*;
+        using reference         = value_type&;
+        using iterator_category = std::forward_iterator_tag;
+
+        bool operator==(const hash_map_iterator &other) const 
+        {
+            return other.hm_ == hm_ && other.idx_ == idx_;
+        }
+
+        bool operator!=(const hash_map_iterator &other) const 
+        {
+            return !(other == *this);
+        }
+
+        hash_map_iterator &operator++() 
+        {
+            ++idx_;
+            advance_past_empty();
+            return *this;
+        }
+
+        reference operator*() const 
+        { 
+            return hm_->m_buckets[idx_]; 
+        }
+        
+        pointer operator->() const 
+        { 
+            return &hm_->m_buckets[idx_]; 
+        }
+
+    private:
+        explicit hash_map_iterator(ContT* hm) : hm_(hm) 
+        { 
+            advance_past_empty(); 
+        }
+
+        explicit hash_map_iterator(ContT* hm, size_type idx) : hm_(hm), idx_(idx) { }
+
+        template <typename OtherContT, typename OtherIterVal>
+        hash_map_iterator(const hash_map_iterator<OtherContT, OtherIterVal>& other)
+            : hm_(other.hm_), idx_(other.idx_) {}
+
+        void advance_past_empty() 
+        {
+            while (idx_ < hm_->m_capacity && hm_->m_infos[idx_].empty(hm_->epoch_base())) 
+            {
+                ++idx_;
+            }
+        }
+
+        ContT* hm_ = nullptr;
+        typename ContT::size_type idx_ = 0;
+        friend ContT;
+    };
+
+    // Keys of a set are not to be changed in place
+    using iterator       = hash_map_iterator<robin_hood_table, std::conditional_t<IS_SET, const value_type, value_type>>;
+    using const_iterator = hash_map_iterator<const robin_hood_table, const value_type>;
+
+protected:
+    // Lookups by another type than key_type need a transparent Hash and
+    // KeyEqual, other keys are converted to key_type first
+    template <typename K>
+    static constexpr bool is_transparent_key = details::is_transparent<Hash>::value &&
+        details::is_transparent<KeyEqual>::value &&
+        !std::is_convertible<K, iterator>::value && !std::is_convertible<K, const_iterator>::value;
+
+    template <typename K>
+    using enable_if_transparent = std::enable_if_t<is_transparent_key<K>, int>;
+
+public:
+    robin_hood_table() : robin_hood_table(minimum_capacity(), key_type())
+    { }
+
+    robin_hood_table(size_type bucket_count) : robin_hood_table(bucket_count, key_type())
+    { }
+
+    explicit robin_hood_table(const allocator_type &alloc)
+        : robin_hood_table(minimum_capacity(), key_type(), alloc)
+    { }
+
+    robin_hood_table(size_type bucket_count, const allocator_type &alloc)
+        : robin_hood_table(bucket_count, key_type(), alloc)
+    { }
+
+    robin_hood_table(size_type bucket_count, key_type empty_key,
+            const allocator_type &alloc = allocator_type())
+        : m_empty_key(empty_key), m_alloc(alloc)
+    {
+        allocate_buckets(compute_closest_capacity(bucket_count));
+    }
+
+    // Bulk build from a range without duplicate keys: the table is sized once
+    // and the values are placed without rehash or duplicate checks. With
+    // threads > 1 (0 for one per hardware thread) the keys are hashed in
+    // parallel, then every thread places the values whose ideal bucket falls
+    // in its own slice of the table. The parallel build keeps 16 bytes per
+    // value of scratch and needs an allocator which constructs values from
+    // several threads at once.
+    template <typename RandomIt>
+    robin_hood_table(unique_keys_t, RandomIt first, RandomIt last, size_type threads = 1,
+            key_type empty_key = key_type(), const allocator_type &alloc = allocator_type())
+        : robin_hood_table(std::max<size_type>(minimum_capacity(),
+                               std::ceil(static_cast<size_type>(last - first) / DEFAULT_MAX_LOAD_FACTOR)),
+                           empty_key, alloc)
+    {
+        static_assert(std::is_base_of<std::random_access_iterator_tag,
+                          typename std::iterator_traits<RandomIt>::iterator_category>::value,
+                      "the bulk build splits the range between threads");
+
+        if (threads == 0)
+        {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        // Slices are kept much larger than the probe runs crossing them
+        threads = std::min(threads, static_cast<size_type>(last - first) / BULK_BUILD_MIN_SLICE + 1);
+
+        if (threads == 1)
+        {
+            for (; first != last; ++first) 
+            {
+                assert(!is_empty_key(key_of(*first)) && "empty key shouldn't be used");
+                insert_unique(value_type(*first), hash_key(key_of(*first)));
+            }
+        }
+        else
+        {
+            bulk_build(first, static_cast<size_type>(last - first), threads);
+        }
+    }
+
+    robin_hood_table(const robin_hood_table &other)
+        : robin_hood_table(other, alloc_traits::select_on_container_copy_construction(other.m_alloc))
+    { }
+
+    // Same capacity as other, occupied buckets are copied in place
+    robin_hood_table(const robin_hood_table &other, const allocator_type &alloc)
+        : GrowthPolicy(other),
+          m_empty_key(other.m_empty_key),
+          m_alloc(alloc),
+          m_max_load_factor(other.m_max_load_factor),
+          m_min_load_factor(other.m_min_load_factor),
+          m_epoch_base(other.m_epoch_base),
+          m_grow_on_next_insert(other.m_grow_on_next_insert)
+    {
+        // A moved-from table has no buckets, neither has its copy
+        if (other.m_capacity == 0)
+        {
+            return;
+        }
+
+        allocate_buckets(other.m_capacity);
+        std::memcpy(static_cast<void*>(m_infos), other.m_infos, m_capacity * sizeof(bucket_info));
+
+        size_t idx = 0;
+        try
+        {
+            for (; idx < m_capacity; ++idx) 
+            {
+                if (!m_infos[idx].empty(epoch_base())) 
+                {
+                    alloc_traits::construct(m_alloc, m_buckets + idx, other.m_buckets[idx]);
+                }
+            }
+        }
+        catch (...)
+        {
+            // Only the buckets before idx were constructed
+            std::memset(static_cast<void*>(m_infos + idx), 0, (m_capacity - idx) * sizeof(bucket_info));
+            destroy_buckets();
+            throw;
+        }
+        m_size = other.m_size;
+    }
+
+    // other is left without buckets: lookups on it find nothing, the next
+    // insert allocates
+    robin_hood_table(robin_hood_table &&other) noexcept
+        : GrowthPolicy(std::move(other)),
+          m_empty_key(other.m_empty_key),
+          m_alloc(std::move(other.m_alloc)),
+          m_buckets(std::exchange(other.m_buckets, nullptr)),
+          m_infos(std::exchange(other.m_infos, nullptr)),
+          m_capacity(std::exchange(other.m_capacity, 0)),
+          m_size(std::exchange(other.m_size, 0)),
+          m_max_load_factor(other.m_max_load_factor),
+          m_min_load_factor(other.m_min_load_factor),
+          m_epoch_base(std::exchange(other.m_epoch_base, 0)),
+          m_grow_on_next_insert(std::exchange(other.m_grow_on_next_insert, false))
+    { }
+
+    robin_hood_table &operator=(const robin_hood_table &other)
+    {
+        if (this != &other)
+        {
+            if constexpr (alloc_traits::propagate_on_container_copy_assignment::value)
+            {
+                robin_hood_table copy(other, other.m_alloc);
+                destroy_buckets();
+                m_alloc = other.m_alloc;
+                swap_storage(copy);
+            }
+            else
+            {
+                robin_hood_table copy(other, m_alloc);
+                swap_storage(copy);
+            }
+        }
+        return *this;
+    }
+
+    robin_hood_table &operator=(robin_hood_table &&other) noexcept(
+        alloc_traits::propagate_on_container_move_assignment::value || alloc_traits::is_always_equal::value)
+    {
+        if (this == &other)
+        {
+            return *this;
+        }
+
+        if constexpr (alloc_traits::propagate_on_container_move_assignment::value)
+        {
+            destroy_buckets();
+            m_alloc = std::move(other.m_alloc);
+            swap_storage(other);
+        }
+        else if (m_alloc == other.m_alloc)
+        {
+            swap_storage(other);
+        }
+        else
+        {
+            // Buckets can't change hands, move the elements one by one
+            robin_hood_table moved(other.m_capacity, other.m_empty_key, m_alloc);
+            moved.m_max_load_factor = other.m_max_load_factor;
+            moved.m_min_load_factor = other.m_min_load_factor;
+            for (size_t idx = 0; idx < other.m_capacity; ++idx) 
+            {
+                if (!other.m_infos[idx].empty(other.epoch_base())) 
+                {
+                    moved.insert_value(std::move(other.m_buckets[idx]));
+                }
+            }
+            swap_storage(moved);
+        }
+        return *this;
+    }
+
+    ~robin_hood_table()
+    {
+        destroy_buckets();
+    }
+
+    robin_hood_table(const robin_hood_table &other, size_type bucket_count)
+        : robin_hood_table(bucket_count, other.m_empty_key, other.get_allocator()) 
+    {
+        m_max_load_factor = other.m_max_load_factor;
+        m_min_load_factor = other.m_min_load_factor;
+        for (auto it = other.cbegin(); it != other.cend(); ++it) 
+        {
+            insert(*it);
+        }
+    }
+
+    allocator_type get_allocator() const noexcept 
+    {
+        return m_alloc;
+    }
+
+    // Iterators
+    iterator begin() noexcept 
+    { 
+        return iterator(this); 
+    }
+
+    const_iterator begin() const noexcept 
+    { 
+        return const_iterator(this); 
+    }
+
+    const_iterator cbegin() const noexcept 
+    { 
+        return const_iterator(this); 
+    }
+
+    iterator end() noexcept 
+    { 
+        return iterator(this, m_capacity); 
+    }
+
+    const_iterator end() const noexcept 
+    {
+        return const_iterator(this, m_capacity);
+    }
+
+    const_iterator cend() const noexcept 
+    {
+        return const_iterator(this, m_capacity);
+    }
+
+    // Capacity
+    bool empty() const noexcept 
+    { 
+        return size() == 0; 
+    }
+
+    size_type size() const noexcept
+    { 
+        return m_size; 
+    }
+
+    size_type max_size() const noexcept 
+    { 
+        return alloc_traits::max_size(m_alloc) / 2; 
+    }
+
+    // Modifiers
+    // O(1) with EpochClear, a memset of the metadata for trivially
+    // destructible values, destroys every value otherwise
+    void clear() noexcept 
+    {
+        if (m_capacity == 0)
+        {
+            return;
+        }
+
+        if constexpr (EpochClear)
+        {
+            if (m_epoch_base < MAX_EPOCH_BASE)
+            {
+                m_epoch_base += bucket_info::EPOCH_STRIDE;
+            }
+            else
+            {
+                std::memset(static_cast<void*>(m_infos), 0, m_capacity * sizeof(bucket_info));
+                m_epoch_base = 0;
+            }
+        }
+        else if constexpr (std::is_trivially_destructible<value_type>::value)
+        {
+            std::memset(static_cast<void*>(m_infos), 0, m_capacity * sizeof(bucket_info));
+        }
+        else
+        {
+            for (size_t idx = 0; idx < m_capacity; ++idx) 
+            {
+                if (!m_infos[idx].empty()) 
+                {
+                    alloc_traits::destroy(m_alloc, m_buckets + idx);
+                    m_infos[idx].clear();
+                }
+            }
+        }
+        m_size = 0;
+        m_grow_on_next_insert = false;
+    }
+
+    // clear() and give the buckets back to the allocator, the table is left
+    // with minimum_capacity() buckets
+    void clear_and_release()
+    {
+        robin_hood_table other(minimum_capacity(), m_empty_key, get_allocator());
+        other.m_max_load_factor = m_max_load_factor;
+        other.m_min_load_factor = m_min_load_factor;
+        swap_storage(other);
+    }
+
+    std::pair<iterator, bool> insert(const value_type &value) 
+    {
+        return insert_value(value);
+    }
+
+    std::pair<iterator, bool> insert(value_type&& value) 
+    {
+        return insert_value(std::move(value));
+    }
+
+    template <typename... Args>
+    std::pair<iterator, bool> emplace(Args &&... args) 
+    {
+        return emplace_impl(std::forward<Args>(args)...);
+    }
+
+    // Never shrinks, erasing while iterating doesn't reallocate the table
+    void erase(iterator it) 
+    { 
+        erase_impl(it); 
+    }
+
+    size_type erase(const key_type &key) 
+    { 
+        const size_type erased = erase_impl(key);
+        shrink_if_sparse();
+        return erased;
+    }
+
+    template <typename K, enable_if_transparent<K> = 0> 
+    size_type erase(const K& x)
+    { 
+        const size_type erased = erase_impl(x);
+        shrink_if_sparse();
+        return erased;
+    }
+
+    // Batches hash BATCH_PREFETCH keys and prefetch their ideal buckets
+    // before probing any of them, hiding the memory latency of large tables
+    template <typename InputIt>
+    void insert_batch(InputIt first, InputIt last) 
+    {
+        std::size_t hashes[BATCH_PREFETCH];
+
+        while (first != last) 
+        {
+            // Grow up front so the prefetched buckets stay valid
+            while (needs_rehash(BATCH_PREFETCH)) 
+            {
+                rehash(next_capacity());
+            }
+
+            InputIt batch = first;
+            std::size_t n = 0;
+            for (; n < BATCH_PREFETCH && first != last; ++n, ++first) 
+            {
+                hashes[n] = prefetch_hash(key_of(*first));
+            }
+
+            for (std::size_t i = 0; i < n; ++i, ++batch) 
+            {
+                insert_value_hashed(hashes[i], *batch);
+            }
+        }
+    }
+
+    template <typename InputIt>
+    size_type erase_batch(InputIt first, InputIt last) 
+    {
+        std::size_t hashes[BATCH_PREFETCH];
+        size_type erased = 0;
+
+        while (first != last) 
+        {
+            InputIt batch = first;
+            std::size_t n = 0;
+            for (; n < BATCH_PREFETCH && first != last; ++n, ++first) 
+            {
+                hashes[n] = prefetch_hash(*first);
+            }
+
+            for (std::size_t i = 0; i < n; ++i, ++batch) 
+            {
+                auto it = find_impl(*batch, hashes[i]);
+                if (it != end()) 
+                {
+                    erase_impl(it);
+                    ++erased;
+                }
+            }
+        }
+
+        shrink_if_sparse();
+        return erased;
+    }
+
+    // Erases the values pred is true for in one pass over the table. Every
+    // survivor moves back at most once, as close to its ideal slot as the
+    // survivors before it allow, instead of one backward shift per erased
+    // value. Invalidates every iterator
+    template <typename Pred>
+    size_type erase_if(Pred pred) 
+    {
+        const size_type erased = erase_if_impl(pred);
+        shrink_if_sparse();
+        return erased;
+    }
+
+    // Allocators which don't propagate on swap must compare equal
+    void swap(robin_hood_table &other) noexcept 
+    {
+        if constexpr (alloc_traits::propagate_on_container_swap::value)
+        {
+            using std::swap;
+            swap(m_alloc, other.m_alloc);
+        }
+        swap_storage(other);
+    }
+
+    // Lookup
+    size_type count(const key_type &key) const 
+    { 
+        return count_impl(key); 
+    }
+
+    template <typename K, enable_if_transparent<K> = 0> 
+    size_type count(const K &x) const
+    {
+        return count_impl(x);
+    }
+
+    iterator find(const key_type &key) 
+    { 
+        return find_impl(key); 
+    }
+
+    template <typename K, enable_if_transparent<K> = 0> 
+    iterator find(const K &x)
+    { 
+        return find_impl(x); 
+    }
+
+    const_iterator find(const key_type &key) const 
+    { 
+        return find_impl(key); 
+    }
+
+    // Writes find() of every key in [first, last) to out
+    template <typename InputIt, typename OutputIt>
+    OutputIt find_batch(InputIt first, InputIt last, OutputIt out) 
+    {
+        return find_batch_impl<iterator>(first, last, out);
+    }
+
+    template <typename InputIt, typename OutputIt>
+    OutputIt find_batch(InputIt first, InputIt last, OutputIt out) const 
+    {
+        return const_cast<robin_hood_table*>(this)->template find_batch_impl<const_iterator>(first, last, out);
+    }
+
+    template <typename K, enable_if_transparent<K> = 0> 
+    const_iterator find(const K &x) const
+    {
+        return find_impl(x);
+    }
+
+    // Bucket interface
+    size_type bucket_count() const noexcept 
+    { 
+        return m_capacity; 
+    }
+
+    size_type max_bucket_count() const noexcept 
+    { 
+        return alloc_traits::max_size(m_alloc); 
+    }
+
+    // Hash policy
+    float load_factor() const noexcept 
+    { 
+        return static_cast<float>(size()) / bucket_count(); 
+    }
+
+    float max_load_factor() const noexcept 
+    { 
+        return m_max_load_factor; 
+    }
+
+    void max_load_factor(float ml)
+    {
+        m_max_load_factor = std::clamp(ml, MINIMUM_MAX_LOAD_FACTOR, MAXIMUM_MAX_LOAD_FACTOR);
+        m_min_load_factor = std::min(m_min_load_factor, m_max_load_factor / 4);
+
+        if (size() > bucket_count() * max_load_factor())
+        {
+            reserve(size());
+        }
+    }
+
+    // 0 disables shrinking on erase, clamped to max_load_factor() / 4
+    float min_load_factor() const noexcept 
+    { 
+        return m_min_load_factor; 
+    }
+
+    void min_load_factor(float ml)
+    {
+        m_min_load_factor = std::clamp(ml, 0.0f, max_load_factor() / 4);
+        shrink_if_sparse();
+    }
+
+    void rehash(size_type count) 
+    {
+#ifdef JW_HASH_MAP_STATS
+        const auto start = std::chrono::steady_clock::now();
+#endif
+        count = std::max(minimum_capacity(), count);
+        count = std::max(count, static_cast<size_type>(size() / max_load_factor()));
+
+        // Keys are known to be unique, so buckets are moved straight into
+        // their Robin Hood position without lookups or load factor checks
+        robin_hood_table other(count, m_empty_key, get_allocator());
+        other.m_max_load_factor = m_max_load_factor;
+        other.m_min_load_factor = m_min_load_factor;
+
+        for (size_t idx = 0; idx < m_capacity; ++idx) 
+        {
+            if (!m_infos[idx].empty(epoch_base())) 
+            {
+                other.insert_unique(std::move(m_buckets[idx]), bucket_hash(idx, other));
+            }
+        }
+
+        swap(other);
+#ifdef JW_HASH_MAP_STATS
+        m_stats.rehashes++;
+        m_stats.rehash_nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+#endif
+    }
+
+    void reserve(std::size_t count)
+    {
+        rehash(std::ceil(count / max_load_factor()));
+    }
+
+    // Smallest table which holds size() elements under max_load_factor()
+    void shrink_to_fit()
+    {
+        rehash(0);
+    }
+
+    void check_for_rehash()
+    {
+        if (needs_rehash())
+        {
+            rehash(next_capacity());
+        }
+    }
+
+    // Observers
+    hasher hash_function() const 
+    { 
+        return hasher(); 
+    }
+
+    key_equal key_eq() const 
+    { 
+        return key_equal(); 
+    }
+
+    // Scans the whole table
+    hash_map_stats stats() const
+    {
+#ifdef JW_HASH_MAP_STATS
+        hash_map_stats res = m_stats;
+#else
+        hash_map_stats res;
+#endif
+        res.size         = size();
+        res.bucket_count = bucket_count();
+
+        std::size_t displacement = 0;
+        for (size_t idx = 0; idx < m_capacity; ++idx) 
+        {
+            if (!m_infos[idx].empty(epoch_base())) 
+            {
+                const std::size_t dist = m_infos[idx].distance(epoch_base());
+                displacement         += dist;
+                res.max_displacement  = std::max(res.max_displacement, dist);
+            }
+        }
+        res.mean_displacement = size() ? static_cast<double>(displacement) / size() : 0.0;
+
+        // Start after an empty bucket so no cluster wraps around the end
+        size_t first = 0;
+        while (first < m_capacity && !m_infos[first].empty(epoch_base())) 
+        {
+            ++first;
+        }
+
+        std::size_t run = 0;
+        for (size_t n = 0, idx = first; n < m_capacity; ++n, idx = probe_next(idx)) 
+        {
+            if (!m_infos[idx].empty(epoch_base())) 
+            {
+                ++run;
+                continue;
+            }
+
+            if (run != 0) 
+            {
+                res.clusters[log2(run)]++;
+                res.max_cluster = std::max(res.max_cluster, run);
+                run = 0;
+            }
+        }
+        if (run != 0) 
+        {
+            res.clusters[log2(run)]++;
+            res.max_cluster = std::max(res.max_cluster, run);
+        }
+
+        return res;
+    }
+
+    void reset_stats() noexcept
+    {
+#ifdef JW_HASH_MAP_STATS
+        m_stats = hash_map_stats();
+#endif
+    }
+
+protected:
+    template <typename, typename, typename, typename, typename, typename, bool>
+    friend class jw::incremental_hash_map;
+
+    template <typename, typename, typename, typename, typename, bool>
+    friend class jw::mapped_hash_map;
+
+    template <typename K>
+    bool is_empty_key(const K &key) const
+    {
+        if constexpr (RESERVES_EMPTY_KEY)
+        {
+            return key_equal()(m_empty_key, key);
+        }
+        else
+        {
+            (void)key;
+            return false;
+        }
+    }
+
+    static const key_type &key_of(const value_type &value) noexcept
+    {
+        if constexpr (IS_SET)
+        {
+            return value;
+        }
+        else
+        {
+            return value.first;
+        }
+    }
+
+    template <typename V>
+    std::pair<iterator, bool> insert_value(V&& value) 
+    {
+        if constexpr (IS_SET)
+        {
+            return emplace_impl(std::forward<V>(value));
+        }
+        else
+        {
+            return emplace_impl(std::forward<V>(value).first, std::forward<V>(value).second);
+        }
+    }
+
+    std::pair<iterator, bool> insert_value_hashed(std::size_t hash, const value_type &value) 
+    {
+        if constexpr (IS_SET)
+        {
+            return emplace_hashed(hash, value);
+        }
+        else
+        {
+            return emplace_hashed(hash, value.first, value.second);
+        }
+    }
+
+    // value_type from the key and, for a map, the arguments of the mapped value
+    template <typename K, typename... Args>
+    static value_type make_value(K&& key, Args&& ...args) 
+    {
+        if constexpr (IS_SET)
+        {
+            static_assert(sizeof...(Args) == 0, "a set stores keys only");
+            return value_type(std::forward<K>(key));
+        }
+        else
+        {
+            return value_type(std::piecewise_construct,
+                              std::forward_as_tuple(std::forward<K>(key)),
+                              std::forward_as_tuple(std::forward<Args>(args)...));
+        }
+    }
+
+    bool needs_rehash(size_type incoming = 1) const noexcept
+    {
+        const bool long_probes = m_grow_on_next_insert &&
+            size() >= bucket_count() * details::MIN_LOAD_FACTOR_FOR_GROWTH;
+
+        return long_probes || size() + incoming > bucket_count() * max_load_factor();
+    }
+
+    void record_find(distance_type dist) noexcept
+    {
+#ifdef JW_HASH_MAP_STATS
+        m_stats.finds++;
+        m_stats.find_probes[std::min<std::size_t>(dist, hash_map_stats::PROBE_BUCKETS - 1)]++;
+#else
+        (void)dist;
+#endif
+    }
+
+    static std::size_t log2(std::size_t n) noexcept
+    {
+        std::size_t res = 0;
+        while (n >>= 1) 
+        {
+            ++res;
+        }
+        return res;
+    }
+
+    tag_type epoch_base() const noexcept
+    {
+        if constexpr (EpochClear)
+        {
+            return m_epoch_base;
+        }
+        else
+        {
+            return 0;
+        }
+    }
+
+    // Shrinks to a table half of max_load_factor() full (a quarter at least
+    // with power of two capacities), the next shrink or grow needs about
+    // size() erases or inserts. min_load_factor() <= max_load_factor() / 4
+    // keeps one shrink from being followed by another right away
+    void shrink_if_sparse()
+    {
+        if (m_min_load_factor > 0 && bucket_count() > minimum_capacity() &&
+            size() < bucket_count() * m_min_load_factor)
+        {
+            rehash(std::ceil(size() / (max_load_factor() / 2)));
+        }
+    }
+
+    size_type next_capacity() const noexcept
+    {
+        return compute_next_capacity(bucket_count());
+    }
+
+    // Move the bucket at idx into other, whose keys must be disjoint from
+    // ours, returns false if the bucket is empty
+    bool migrate_bucket(size_t idx, robin_hood_table& other)
+    {
+        if (m_infos[idx].empty(epoch_base()))
+        {
+            return false;
+        }
+
+        other.insert_unique(std::move(m_buckets[idx]), bucket_hash(idx, other));
+        erase_impl(iterator(this, idx));
+        return true;
+    }
+
+    // key is only forwarded, so moved from, on insertion
+    template <typename K, typename... Args>
+    std::pair<iterator, bool> emplace_impl(K&& key, Args&& ...args) 
+    {
+        assert(!is_empty_key(key) && "empty key shouldn't be used");
+
+        check_for_rehash();
+
+        const std::size_t hash = hash_key(key);
+        return emplace_hashed(hash, std::forward<K>(key), std::forward<Args>(args)...);
+    }
+
+    template <typename K, typename... Args>
+    std::pair<iterator, bool> emplace_hashed(std::size_t hash, K&& key, Args&& ...args) 
+    {
+        size_t        idx  = bucket_for_hash(hash);
+        distance_type     dist = 0;
+
+        for (; ; idx = probe_next(idx), ++dist) 
+        {
+            bucket_info& info = m_infos[idx];
+            if (info.empty(epoch_base())) 
+            {
+                if (dist > details::MAX_DISTANCE)
+                {
+                    throw_probe_overflow();
+                }
+
+                if constexpr (IS_SET)
+                {
+                    static_assert(sizeof...(Args) == 0, "a set stores keys only");
+                    alloc_traits::construct(m_alloc, m_buckets + idx, std::forward<K>(key));
+                }
+                else
+                {
+                    alloc_traits::construct(m_alloc, m_buckets + idx, std::piecewise_construct,
+                                            std::forward_as_tuple(std::forward<K>(key)),
+                                            std::forward_as_tuple(std::forward<Args>(args)...));
+                }
+                info.set_distance(dist, epoch_base());
+                info.set_hash(hash);
+                m_size++;
+                m_grow_on_next_insert |= dist + 1 >= details::DIST_LIMIT;
+                return {iterator(this, idx), true};
+            } 
+            else if (info.distance(epoch_base()) < dist) 
+            {
+                // Robin Hood: the key can't be further away, take over the
+                // bucket from its richer owner
+                break;
+            }
+            else if (info.bucket_hash_equal(hash) && key_equal()(key_of(m_buckets[idx]), key)) 
+            {
+                return {iterator(this, idx), false};
+            }
+        }
+
+        value_type displaced = make_value(std::forward<K>(key), std::forward<Args>(args)...);
+        insert_displacing(idx, dist, hash, std::move(displaced));
+        m_size++;
+        return {iterator(this, idx), true};
+    }
+
+    static constexpr const size_type BULK_BUILD_MIN_SLICE = 4096;
+
+    // Hashes the range in parallel, counting sorts its positions by slice,
+    // places every slice in parallel and finishes sequentially with the
+    // values whose probe run would have crossed the end of their slice
+    template <typename RandomIt>
+    void bulk_build(RandomIt first, size_type n, size_type threads)
+    {
+        std::vector<std::size_t> hashes(n);
+        std::vector<size_type>   order(n);
+        std::vector<size_type>   counts(threads * threads, 0);
+
+        // counts[chunk * threads + slice]: values of the input chunk whose
+        // ideal bucket is in slice, turned into their offsets in order
+        auto chunk_begin = [&](size_type chunk) { return n * chunk / threads; };
+        auto slice_of    = [&](std::size_t hash) { return bucket_for_hash(hash) * threads / m_capacity; };
+
+        parallel_for(threads, [&](size_type chunk)
+        {
+            for (size_type i = chunk_begin(chunk); i < chunk_begin(chunk + 1); ++i) 
+            {
+                assert(!is_empty_key(key_of(first[i])) && "empty key shouldn't be used");
+                hashes[i] = hash_key(key_of(first[i]));
+                counts[chunk * threads + slice_of(hashes[i])]++;
+            }
+        });
+
+        std::vector<size_type> slice_begin(threads + 1, 0);
+        size_type offset = 0;
+        for (size_type slice = 0; slice < threads; ++slice) 
+        {
+            slice_begin[slice] = offset;
+            for (size_type chunk = 0; chunk < threads; ++chunk) 
+            {
+                const size_type count = counts[chunk * threads + slice];
+                counts[chunk * threads + slice] = offset;
+                offset += count;
+            }
+        }
+        slice_begin[threads] = n;
+
+        parallel_for(threads, [&](size_type chunk)
+        {
+            for (size_type i = chunk_begin(chunk); i < chunk_begin(chunk + 1); ++i) 
+            {
+                order[counts[chunk * threads + slice_of(hashes[i])]++] = i;
+            }
+        });
+
+        // A slice owns the buckets [ceil(capacity * slice / threads), ...)
+        // which are exactly the buckets slice_of() maps to it
+        std::vector<std::vector<value_type, allocator_type>> overflow(
+            threads, std::vector<value_type, allocator_type>(m_alloc));
+        std::vector<size_type> placed(threads, 0);
+        std::vector<char>      grow(threads, false);
+
+        parallel_for(threads, [&](size_type slice)
+        {
+            const size_t end = (m_capacity * (slice + 1) + threads - 1) / threads;
+            size_type    count = 0;
+            bool         far   = false;
+            for (size_type k = slice_begin[slice]; k < slice_begin[slice + 1]; ++k) 
+            {
+                const size_type i = order[k];
+                value_type value(first[i]);
+                if (place_before(end, hashes[i], value, far))
+                {
+                    count++;
+                }
+                else
+                {
+                    overflow[slice].push_back(std::move(value));
+                }
+            }
+            placed[slice] = count;
+            grow[slice]   = far;
+        });
+
+        for (size_type slice = 0; slice < threads; ++slice) 
+        {
+            m_size += placed[slice];
+            m_grow_on_next_insert |= grow[slice] != 0;
+        }
+        for (auto &values : overflow) 
+        {
+            for (auto &value : values) 
+            {
+                const std::size_t hash = hash_key(key_of(value));
+                insert_unique(std::move(value), hash);
+            }
+        }
+    }
+
+    // Runs fn(0) ... fn(threads - 1) on as many threads, rethrows the first
+    // exception once they all finished
+    template <typename Fn>
+    static void parallel_for(size_type threads, Fn&& fn)
+    {
+        std::vector<std::exception_ptr> errors(threads);
+        std::vector<std::thread>        workers;
+        workers.reserve(threads - 1);
+
+        auto run = [&](size_type t)
+        {
+            try
+            {
+                fn(t);
+            }
+            catch (...)
+            {
+                errors[t] = std::current_exception();
+            }
+        };
+
+        try
+        {
+            for (size_type t = 1; t < threads; ++t) 
+            {
+                workers.emplace_back(run, t);
+            }
+        }
+        catch (...)
+        {
+            for (auto &worker : workers) 
+            {
+                worker.join();
+            }
+            throw;
+        }
+        run(0);
+        for (auto &worker : workers) 
+        {
+            worker.join();
+        }
+
+        for (auto &error : errors) 
+        {
+            if (error)
+            {
+                std::rethrow_exception(error);
+            }
+        }
+    }
+
+    // insert_displacing() bounded to the buckets before end. Leaves in value
+    // what would have to cross end and returns false, buckets are only
+    // written by the thread which owns them
+    bool place_before(size_t end, std::size_t hash, value_type &value, bool &far)
+    {
+        using std::swap;
+
+        bucket_info carried;
+        carried.set_distance(0, epoch_base());
+        carried.set_hash(hash);
+
+        for (size_t idx = bucket_for_hash(hash); idx < end; ++idx) 
+        {
+            bucket_info& info = m_infos[idx];
+            if (info.empty(epoch_base())) 
+            {
+                alloc_traits::construct(m_alloc, m_buckets + idx, std::move(value));
+                info = carried;
+                return true;
+            }
+
+            if (info.distance(epoch_base()) < carried.distance(epoch_base())) 
+            {
+                swap(m_buckets[idx], value);
+                swap(info, carried);
+            }
+
+            // The sequential insert of value reports the overflow
+            if (carried.distance(epoch_base()) == details::MAX_DISTANCE)
+            {
+                return false;
+            }
+            carried.set_distance(carried.distance(epoch_base()) + 1, epoch_base());
+            far |= carried.distance(epoch_base()) + 1 >= details::DIST_LIMIT;
+        }
+        return false;
+    }
+
+    void insert_unique(value_type&& value, std::size_t hash)
+    {
+        insert_displacing(bucket_for_hash(hash), 0, hash, std::move(value));
+        m_size++;
+    }
+
+    // Place value at idx (probe distance dist) and push the owners of the
+    // following buckets further until an empty bucket is found
+    void insert_displacing(size_t idx, distance_type dist, std::size_t hash, value_type&& value)
+    {
+        using std::swap;
+
+        check_displacement(idx, dist);
+
+        bucket_info carried;
+        carried.set_distance(dist, epoch_base());
+        carried.set_hash(hash);
+
+        for (; ; idx = probe_next(idx)) 
+        {
+            bucket_info& info = m_infos[idx];
+            if (info.empty(epoch_base())) 
+            {
+                alloc_traits::construct(m_alloc, m_buckets + idx, std::move(value));
+                info = carried;
+                return;
+            }
+
+            if (info.distance(epoch_base()) < carried.distance(epoch_base())) 
+            {
+                swap(m_buckets[idx], value);
+                swap(info, carried);
+            }
+
+            carried.set_distance(carried.distance(epoch_base()) + 1, epoch_base());
+            if (carried.distance(epoch_base()) + 1 >= details::DIST_LIMIT) 
+            {
+                m_grow_on_next_insert = true;
+            }
+        }
+    }
+
+    // Throws before anything moves if insert_displacing(idx, dist) would push
+    // a bucket past MAX_DISTANCE: it shifts every bucket from idx to the next
+    // empty one by one. Distances stay below DIST_LIMIT until
+    // m_grow_on_next_insert is set, only then is the run scanned
+    void check_displacement(size_t idx, distance_type dist) const
+    {
+        if (!m_grow_on_next_insert && dist < details::DIST_LIMIT)
+        {
+            return;
+        }
+
+        if (dist > details::MAX_DISTANCE)
+        {
+            throw_probe_overflow();
+        }
+        for (; !m_infos[idx].empty(epoch_base()); idx = probe_next(idx)) 
+        {
+            if (m_infos[idx].distance(epoch_base()) >= details::MAX_DISTANCE)
+            {
+                throw_probe_overflow();
+            }
+        }
+    }
+
+    // Growing doesn't split a run of equal hashes: the hasher is to blame
+    [[noreturn]] static void throw_probe_overflow()
+    {
+        throw std::length_error("hash_map: too many keys with the same hash");
+    }
+
+    // Hash of the bucket at idx for its insertion into other, reuses the
+    // stored hash when other computes the same index from it
+    std::size_t bucket_hash(size_t idx, const robin_hood_table& other) const
+    {
+        if (use_stored_hash_on_rehash(other.bucket_count()))
+        {
+            return m_infos[idx].truncated_hash();
+        }
+
+        return hash_key(key_of(m_buckets[idx]));
+    }
+
+    static constexpr bool use_stored_hash_on_rehash(size_type bucket_count) noexcept
+    {
+        return StoreHash && details::index_from_low_bits<GrowthPolicy>::value &&
+            bucket_count - 1 <= std::numeric_limits<details::truncated_hash_type>::max();
+    }
+
+    void erase_impl(iterator it) 
+    {
+        size_t bucket = it.idx_;
+#ifdef JW_HASH_MAP_STATS
+        m_stats.erases++;
+#endif
+
+        // Backward shift: pull every following bucket which is not in its
+        // ideal slot one step closer to it
+        for (size_t idx = probe_next(bucket); ; idx = probe_next(idx)) 
+        {
+            bucket_info& info = m_infos[idx];
+            if (info.empty(epoch_base()) || info.distance(epoch_base()) == 0) 
+            {
+                alloc_traits::destroy(m_alloc, m_buckets + bucket);
+                m_infos[bucket].clear();
+                --m_size;
+
+                return;
+            }
+
+#ifdef JW_HASH_MAP_STATS
+            m_stats.erase_shifts++;
+#endif
+            m_buckets[bucket] = std::move(m_buckets[idx]);
+            m_infos[bucket] = info;
+            m_infos[bucket].set_distance(info.distance(epoch_base()) - 1, epoch_base());
+            bucket = idx;
+        }
+    }
+
+    // Scans from an empty bucket so no cluster is entered halfway. free is
+    // the first bucket after the last survivor: the next survivor goes there
+    // when it is between its ideal slot and the survivor, else to its ideal
+    // slot. A throwing pred stops the erasing but not the compaction, which
+    // must close the holes already made
+    template <typename Pred>
+    size_type erase_if_impl(Pred &pred) 
+    {
+        if (m_size == 0)
+        {
+            return 0;
+        }
+
+        size_t start = 0;
+        while (!m_infos[start].empty(epoch_base())) 
+        {
+            ++start;
+        }
+
+        size_type          erased = 0;
+        std::exception_ptr error;
+        size_t             free   = start;
+
+        for (size_t n = 1, idx = probe_next(start); n < m_capacity; ++n, idx = probe_next(idx)) 
+        {
+            bucket_info& info = m_infos[idx];
+            if (info.empty(epoch_base())) 
+            {
+                free = idx;
+                continue;
+            }
+
+            if (!error)
+            {
+                bool erase = false;
+                try
+                {
+                    erase = pred(static_cast<const value_type&>(m_buckets[idx]));
+                }
+                catch (...)
+                {
+                    error = std::current_exception();
+                }
+
+                if (erase)
+                {
+                    alloc_traits::destroy(m_alloc, m_buckets + idx);
+                    info.clear();
+                    ++erased;
+                    continue;
+                }
+            }
+
+            const distance_type dist = info.distance(epoch_base());
+            const size_t        home = idx >= dist ? idx - dist : idx + m_capacity - dist;
+            const size_t        gap  = free >= home ? free - home : free + m_capacity - home;
+
+            // Every bucket from free to idx is empty by now
+            const size_t target = gap <= dist ? free : home;
+
+            if (target != idx)
+            {
+                alloc_traits::construct(m_alloc, m_buckets + target, std::move(m_buckets[idx]));
+                alloc_traits::destroy(m_alloc, m_buckets + idx);
+                m_infos[target] = info;
+                m_infos[target].set_distance(dist - static_cast<distance_type>(
+                    idx >= target ? idx - target : idx + m_capacity - target), epoch_base());
+                info.clear();
+#ifdef JW_HASH_MAP_STATS
+                m_stats.erase_shifts++;
+#endif
+            }
+            free = probe_next(target);
+        }
+
+        m_size -= erased;
+#ifdef JW_HASH_MAP_STATS
+        m_stats.erases += erased;
+#endif
+
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+        return erased;
+    }
+
+    template <typename K> 
+    size_type erase_impl(const K &key) 
+    {
+        auto it = find_impl(key);
+        if (it != end()) {
+            erase_impl(it);
+            return 1;
+        }
+
+        return 0;
+    }
+
+    template <typename K> 
+    size_t count_impl(const K& key) const 
+    {
+        return find_impl(key) == end() ? 0 : 1;
+    }
+
+    template <typename K> 
+    iterator find_impl(const K &key) 
+    {
+        return find_impl(key, hash_key(key));
+    }
+
+    template <typename K> 
+    iterator find_impl(const K &key, std::size_t hash) 
+    {
+        assert(!is_empty_key(key) && "empty key shouldn't be used");
+
+        // Moved-from tables keep no buckets until the next insert
+        if (m_capacity == 0)
+        {
+            return end();
+        }
+
+        size_t        idx  = bucket_for_hash(hash);
+        distance_type     dist = 0;
+
+        for (; ; idx = probe_next(idx), ++dist) 
+        {
+            const bucket_info& info = m_infos[idx];
+            if (info.empty(epoch_base()) || info.distance(epoch_base()) < dist) 
+            {
+                record_find(dist);
+                return end();
+            }
+
+            if (info.bucket_hash_equal(hash) && key_equal()(key_of(m_buckets[idx]), key)) 
+            {
+                record_find(dist);
+                return iterator(this, idx);
+            }
+        }
+    }
+
+    template <typename K> 
+    const_iterator find_impl(const K &key) const 
+    {
+        return const_cast<robin_hood_table*>(this)->find_impl(key);
+    }
+
+    template <typename K>
+    std::size_t hash_key(const K& key) const noexcept(noexcept(hasher()(key))) 
+    {
+        return details::table_hash<Hash>(hasher()(key));
+    }
+
+    template <typename K>
+    std::size_t prefetch_hash(const K& key) const 
+    {
+        const std::size_t hash = hash_key(key);
+        if (m_capacity == 0)
+        {
+            return hash;
+        }
+
+        const size_t idx = bucket_for_hash(hash);
+        details::prefetch(&m_infos[idx]);
+        details::prefetch(&m_buckets[idx]);
+        return hash;
+    }
+
+    template <typename Iter, typename InputIt, typename OutputIt>
+    OutputIt find_batch_impl(InputIt first, InputIt last, OutputIt out) 
+    {
+        std::size_t hashes[BATCH_PREFETCH];
+
+        while (first != last) 
+        {
+            InputIt batch = first;
+            std::size_t n = 0;
+            for (; n < BATCH_PREFETCH && first != last; ++n, ++first) 
+            {
+                hashes[n] = prefetch_hash(*first);
+            }
+
+            for (std::size_t i = 0; i < n; ++i, ++batch) 
+            {
+                *out++ = Iter(find_impl(*batch, hashes[i]));
+            }
+        }
+
+        return out;
+    }
+
+    size_t bucket_for_hash(std::size_t hash) const noexcept 
+    {
+        return compute_index(hash, m_capacity);
+    }
+
+    size_t probe_next(size_t idx) const noexcept 
+    {
+        return idx + 1 < m_capacity ? idx + 1 : 0;
+    }
+
+    // Everything but the allocator
+    void swap_storage(robin_hood_table &other) noexcept
+    {
+        std::swap(static_cast<GrowthPolicy&>(*this), static_cast<GrowthPolicy&>(other));
+        std::swap(m_buckets, other.m_buckets);
+        std::swap(m_infos, other.m_infos);
+        std::swap(m_capacity, other.m_capacity);
+        std::swap(m_size, other.m_size);
+        std::swap(m_empty_key, other.m_empty_key);
+        std::swap(m_max_load_factor, other.m_max_load_factor);
+        std::swap(m_min_load_factor, other.m_min_load_factor);
+        std::swap(m_epoch_base, other.m_epoch_base);
+        std::swap(m_grow_on_next_insert, other.m_grow_on_next_insert);
+    }
+
+    void allocate_buckets(size_type capacity)
+    {
+        info_allocator info_alloc(m_alloc);
+
+        m_buckets  = alloc_traits::allocate(m_alloc, capacity);
+        try
+        {
+            m_infos = allocate_infos(info_alloc, capacity);
+        }
+        catch (...)
+        {
+            alloc_traits::deallocate(m_alloc, m_buckets, capacity);
+            m_buckets = nullptr;
+            throw;
+        }
+        m_capacity = capacity;
+    }
+
+    void destroy_buckets() noexcept
+    {
+        if (m_buckets == nullptr)
+        {
+            return;
+        }
+
+        if (!std::is_trivially_destructible<value_type>::value)
+        {
+            for (size_t idx = 0; idx < m_capacity; ++idx) 
+            {
+                if (!m_infos[idx].empty(epoch_base())) 
+                {
+                    alloc_traits::destroy(m_alloc, m_buckets + idx);
+                }
+            }
+        }
+
+        info_allocator info_alloc(m_alloc);
+        deallocate_infos(info_alloc, m_infos, m_capacity);
+        alloc_traits::deallocate(m_alloc, m_buckets, m_capacity);
+
+        m_buckets  = nullptr;
+        m_infos    = nullptr;
+        m_capacity = 0;
+        m_size     = 0;
+    }
+
+    // All bits zero is an empty bucket_info. calloc gets big blocks straight
+    // from the OS, already zeroed, without touching their pages
+    static bucket_info* allocate_infos(info_allocator &alloc, size_type capacity)
+    {
+        static_assert(std::is_trivially_copyable<bucket_info>::value, "bucket_info is copied as bytes");
+
+        if constexpr (std::is_same<info_allocator, std::allocator<bucket_info>>::value)
+        {
+            (void)alloc;
+            void* p = std::calloc(capacity, sizeof(bucket_info));
+            if (p == nullptr)
+            {
+                throw std::bad_alloc();
+            }
+            return static_cast<bucket_info*>(p);
+        }
+        else
+        {
+            bucket_info* p = info_traits::allocate(alloc, capacity);
+            std::memset(static_cast<void*>(p), 0, capacity * sizeof(bucket_info));
+            return p;
+        }
+    }
+
+    static void deallocate_infos(info_allocator &alloc, bucket_info* p, size_type capacity) noexcept
+    {
+        if constexpr (std::is_same<info_allocator, std::allocator<bucket_info>>::value)
+        {
+            (void)alloc;
+            (void)capacity;
+            std::free(p);
+        }
+        else
+        {
+            info_traits::deallocate(alloc, p, capacity);
+        }
+    }
+
+private:
+    key_type       m_empty_key;
+    allocator_type m_alloc;
+    value_type*    m_buckets             = nullptr;
+    bucket_info*   m_infos               = nullptr;
+    size_t         m_capacity            = 0;
+    size_t         m_size                = 0;
+    float          m_max_load_factor     = DEFAULT_MAX_LOAD_FACTOR;
+    float          m_min_load_factor     = DEFAULT_MIN_LOAD_FACTOR;
+    tag_type       m_epoch_base          = 0;
+#ifdef JW_HASH_MAP_STATS
+    hash_map_stats m_stats;
+#endif
+    bool           m_grow_on_next_insert = false;
+};
+
+}
+}
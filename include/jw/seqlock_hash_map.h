@@ -0,0 +1,769 @@
+/**
+ * @file seqlock_hash_map.h
+ * @author jian wu (jian.wu_93@foxmail.com)
+ * @brief Concurrent hash map for read-mostly workloads, lookups take no lock.
+ *
+ * Same open addressing layout as jw::hash_map (linear probing, Robin Hood
+ * displacement, backward shift erase, probe distance per bucket). Buckets are
+ * grouped into segments of SEGMENT_SIZE buckets, each with a version counter
+ * (seqlock): writers are serialized by a mutex and make the version of every
+ * segment they modify odd while they modify it. Readers copy the buckets they
+ * probe without writing to them, then check that the version of every
+ * segment they read didn't change, and retry otherwise.
+ *
+ * Growing the map builds a new table which is published with a single
+ * pointer swap (RCU style). Readers announce themselves in one of
+ * READER_SLOTS per-cache-line slots, counted under the phase they started
+ * in. Publishing a table flips the phase: the retired tables are freed by
+ * the next growth, clear() or collect() finding no reader left in the old
+ * phase, readers which started since can't see them (a grace period).
+ *
+ * The announcement is the one write of a lookup: a seq_cst fetch_add and a
+ * fetch_sub on the slot of the calling thread. Threads share a slot when
+ * their index is the same modulo READER_SLOTS, and then take turns owning
+ * its cache line. A read_scope (pin()) announces once for all the lookups
+ * made through it. Retired tables wait for it, so it should not outlive a
+ * batch of lookups.
+ * Clearing the map empties the current table in place under the seqlock.
+ * Hashes are folded by details::table_hash before probing. Tables only
+ * retire when the map doubles, so they never hold more memory than the
+ * current one.
+ *
+ * Keys and values are copied in and out as bytes, they must be trivially
+ * copyable. Lookups return copies. As in jw::hash_map, an insert which would
+ * put a key 65535 buckets or more from its slot throws std::length_error.
+ *
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "hash_map.h"
+
+namespace jw
+{
+
+static constexpr const std::size_t SEGMENT_SHIFT = 6;
+static constexpr const std::size_t SEGMENT_SIZE  = std::size_t{1} << SEGMENT_SHIFT;
+static constexpr const std::size_t READER_SLOTS  = 64;
+
+// Segments a lookup validates at once, longer probes fall back to the lock
+static constexpr const std::size_t MAX_READ_SEGMENTS = 8;
+
+template <typename Key,
+          typename T,
+          typename Hash     = std::hash<Key>,
+          typename KeyEqual = std::equal_to<void>>
+class seqlock_hash_map
+{
+    static_assert(std::is_trivially_copyable<Key>::value &&
+                  std::is_trivially_copyable<T>::value,
+                  "seqlock_hash_map copies keys and values as bytes");
+
+public:
+    using key_type    = Key;
+    using mapped_type = T;
+    using value_type  = std::pair<Key, T>;
+    using size_type   = std::size_t;
+    using hasher      = Hash;
+    using key_equal   = KeyEqual;
+
+private:
+    using bucket_info   = details::bucket_info<false>;
+    using distance_type = details::distance_type;
+    using version_type  = std::uint32_t;
+
+    struct bucket
+    {
+        bucket_info   m_info;
+        unsigned char m_key[sizeof(Key)];
+        unsigned char m_value[sizeof(T)];
+    };
+
+    struct table
+    {
+        explicit table(size_type capacity)
+            : m_capacity(capacity),
+              m_buckets(new bucket[capacity]()),
+              m_versions(new std::atomic<version_type>[(capacity + SEGMENT_SIZE - 1) / SEGMENT_SIZE]())
+        { }
+
+        size_type                                 m_capacity;
+        std::unique_ptr<bucket[]>                 m_buckets;
+        std::unique_ptr<std::atomic<version_type>[]> m_versions;
+    };
+
+    // Lookups in flight per phase
+    struct alignas(CACHE_LINE_SIZE) reader_slot
+    {
+        std::atomic<std::size_t> m_readers[2] = {};
+    };
+
+    // Keeps the current table alive for the duration of a lookup. The phase
+    // is read again after the increment: a reader counted in a phase is sure
+    // to be waited for by the writer flipping out of it
+    class read_guard
+    {
+    public:
+        explicit read_guard(const seqlock_hash_map& hm) : m_slot(hm.m_readers[reader_index()])
+        {
+            for (;;)
+            {
+                m_phase = hm.m_phase.load(std::memory_order_seq_cst);
+                m_slot.m_readers[m_phase].fetch_add(1, std::memory_order_seq_cst);
+                if (hm.m_phase.load(std::memory_order_seq_cst) == m_phase)
+                {
+                    break;
+                }
+                m_slot.m_readers[m_phase].fetch_sub(1, std::memory_order_release);
+            }
+        }
+
+        ~read_guard()
+        {
+            m_slot.m_readers[m_phase].fetch_sub(1, std::memory_order_release);
+        }
+
+        read_guard(const read_guard&)            = delete;
+        read_guard& operator=(const read_guard&) = delete;
+
+    private:
+        reader_slot& m_slot;
+        unsigned     m_phase = 0;
+    };
+
+public:
+    seqlock_hash_map() : seqlock_hash_map(details::power_of_two_growth_policy<>::minimum_capacity())
+    { }
+
+    explicit seqlock_hash_map(size_type bucket_count)
+        : m_table(new table(normalize_capacity(bucket_count)))
+    { }
+
+    seqlock_hash_map(const seqlock_hash_map&)            = delete;
+    seqlock_hash_map& operator=(const seqlock_hash_map&) = delete;
+
+    ~seqlock_hash_map()
+    {
+        delete m_table.load(std::memory_order_relaxed);
+    }
+
+    // Capacity
+    bool empty() const noexcept
+    {
+        return size() == 0;
+    }
+
+    size_type size() const noexcept
+    {
+        return m_size.load(std::memory_order_relaxed);
+    }
+
+    size_type bucket_count() const noexcept
+    {
+        read_guard guard(*this);
+        return m_table.load(std::memory_order_seq_cst)->m_capacity;
+    }
+
+    // Lookup, never blocks unless a probe spans more than MAX_READ_SEGMENTS
+    template <typename K>
+    bool find(const K &key, mapped_type &out) const
+    {
+        read_guard guard(*this);
+        return find_pinned(key, out);
+    }
+
+    template <typename K>
+    std::optional<mapped_type> find(const K &key) const
+    {
+        mapped_type out;
+        if (find(key, out))
+        {
+            return out;
+        }
+        return std::nullopt;
+    }
+
+    template <typename K>
+    size_type count(const K &key) const
+    {
+        mapped_type out;
+        return find(key, out) ? 1 : 0;
+    }
+
+    /**
+     * @brief Lookups sharing one announcement in the reader slots, for
+     * batches of finds which would otherwise pay one fetch_add and one
+     * fetch_sub each.
+     */
+    class read_scope
+    {
+    public:
+        explicit read_scope(const seqlock_hash_map &hm) : m_map(hm), m_guard(hm)
+        { }
+
+        template <typename K>
+        bool find(const K &key, mapped_type &out) const
+        {
+            return m_map.find_pinned(key, out);
+        }
+
+        template <typename K>
+        std::optional<mapped_type> find(const K &key) const
+        {
+            mapped_type out;
+            if (find(key, out))
+            {
+                return out;
+            }
+            return std::nullopt;
+        }
+
+        template <typename K>
+        size_type count(const K &key) const
+        {
+            mapped_type out;
+            return find(key, out) ? 1 : 0;
+        }
+
+    private:
+        const seqlock_hash_map& m_map;
+        read_guard              m_guard;
+    };
+
+    read_scope pin() const
+    {
+        return read_scope(*this);
+    }
+
+    // Modifiers, serialized by the write mutex
+    bool insert(const value_type &value)
+    {
+        std::lock_guard<std::mutex> lock(m_write_mutex);
+        return insert_locked(value.first, value.second, false);
+    }
+
+    // Returns true if the value was inserted, false if it was assigned
+    bool insert_or_assign(const key_type &key, const mapped_type &value)
+    {
+        std::lock_guard<std::mutex> lock(m_write_mutex);
+        return insert_locked(key, value, true);
+    }
+
+    template <typename K>
+    size_type erase(const K &key)
+    {
+        std::lock_guard<std::mutex> lock(m_write_mutex);
+        return erase_locked(key);
+    }
+
+    // Keeps the bucket count, lookups running meanwhile retry until every
+    // bucket is empty
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(m_write_mutex);
+        clear_locked(*m_table.load(std::memory_order_relaxed));
+        m_size.store(0, std::memory_order_relaxed);
+        m_long_probes = false;
+        collect_locked();
+    }
+
+    void reserve(size_type count)
+    {
+        std::lock_guard<std::mutex> lock(m_write_mutex);
+        const size_type capacity = normalize_capacity(std::ceil(count / DEFAULT_MAX_LOAD_FACTOR));
+        if (capacity > m_table.load(std::memory_order_relaxed)->m_capacity)
+        {
+            grow(capacity);
+        }
+    }
+
+    // Frees the retired tables no lookup can still read, returns true if none
+    // is left
+    bool collect()
+    {
+        std::lock_guard<std::mutex> lock(m_write_mutex);
+        return collect_locked();
+    }
+
+    // Observers
+    hasher hash_function() const
+    {
+        return hasher();
+    }
+
+    key_equal key_eq() const
+    {
+        return key_equal();
+    }
+
+private:
+    enum class read_result
+    {
+        found,
+        not_found,
+        retry,
+        too_long
+    };
+
+    // The caller holds a read_guard, which also covers the locked fallback
+    template <typename K>
+    bool find_pinned(const K &key, mapped_type &out) const
+    {
+        const std::size_t hash = hash_key(key);
+        for (;;)
+        {
+            const table* t = m_table.load(std::memory_order_seq_cst);
+            const read_result res = try_find(*t, key, hash, out);
+            if (res == read_result::too_long)
+            {
+                break;
+            }
+            if (res != read_result::retry)
+            {
+                return res == read_result::found;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(m_write_mutex);
+        return find_locked(*m_table.load(std::memory_order_relaxed), key, hash, out);
+    }
+
+    template <typename K>
+    static std::size_t hash_key(const K &key)
+    {
+        return details::table_hash<hasher>(hasher()(key));
+    }
+
+    static key_type load_key(const bucket& b) noexcept
+    {
+        key_type key;
+        std::memcpy(static_cast<void*>(&key), b.m_key, sizeof(Key));
+        return key;
+    }
+
+    static mapped_type load_value(const bucket& b) noexcept
+    {
+        mapped_type value;
+        std::memcpy(static_cast<void*>(&value), b.m_value, sizeof(T));
+        return value;
+    }
+
+    static void store(bucket& b, const key_type& key, const mapped_type& value) noexcept
+    {
+        std::memcpy(b.m_key, static_cast<const void*>(&key), sizeof(Key));
+        std::memcpy(b.m_value, static_cast<const void*>(&value), sizeof(T));
+    }
+
+    template <typename K>
+    read_result try_find(const table& t, const K &key, std::size_t hash, mapped_type &out) const
+    {
+        size_type    segments[MAX_READ_SEGMENTS];
+        version_type versions[MAX_READ_SEGMENTS];
+        size_type    nsegments = 0;
+        bool         found     = false;
+        bool         too_long  = false;
+        mapped_type  value;
+
+        size_type idx = hash & (t.m_capacity - 1);
+        for (distance_type dist = 0; ; idx = probe_next(t, idx), ++dist)
+        {
+            const size_type seg = idx >> SEGMENT_SHIFT;
+            if (nsegments == 0 || segments[nsegments - 1] != seg)
+            {
+                if (nsegments == MAX_READ_SEGMENTS)
+                {
+                    too_long = true;
+                    break;
+                }
+
+                const version_type v = t.m_versions[seg].load(std::memory_order_acquire);
+                if (v & 1)
+                {
+                    return read_result::retry;
+                }
+                segments[nsegments]   = seg;
+                versions[nsegments++] = v;
+            }
+
+            const bucket& b = t.m_buckets[idx];
+            bucket_info info;
+            std::memcpy(static_cast<void*>(&info), &b.m_info, sizeof(info));
+
+            if (info.empty() || info.distance() < dist)
+            {
+                break;
+            }
+
+            if (key_equal()(load_key(b), key))
+            {
+                value = load_value(b);
+                found = true;
+                break;
+            }
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        for (size_type i = 0; i < nsegments; ++i)
+        {
+            if (t.m_versions[segments[i]].load(std::memory_order_relaxed) != versions[i])
+            {
+                return read_result::retry;
+            }
+        }
+
+        if (too_long)
+        {
+            return read_result::too_long;
+        }
+        if (found)
+        {
+            out = value;
+            return read_result::found;
+        }
+        return read_result::not_found;
+    }
+
+    template <typename K>
+    bool find_locked(const table& t, const K &key, std::size_t hash, mapped_type &out) const
+    {
+        const size_type idx = find_idx(t, key, hash);
+        if (idx == t.m_capacity)
+        {
+            return false;
+        }
+        out = load_value(t.m_buckets[idx]);
+        return true;
+    }
+
+    template <typename K>
+    size_type find_idx(const table& t, const K &key, std::size_t hash) const
+    {
+        size_type idx = hash & (t.m_capacity - 1);
+        for (distance_type dist = 0; ; idx = probe_next(t, idx), ++dist)
+        {
+            const bucket& b = t.m_buckets[idx];
+            if (b.m_info.empty() || b.m_info.distance() < dist)
+            {
+                return t.m_capacity;
+            }
+            if (key_equal()(load_key(b), key))
+            {
+                return idx;
+            }
+        }
+    }
+
+    // Segments made odd by the running write, made even again on destruction
+    class write_section
+    {
+    public:
+        explicit write_section(table& t) : m_table(t)
+        { }
+
+        ~write_section()
+        {
+            for (size_type seg : m_segments)
+            {
+                auto& version = m_table.m_versions[seg];
+                version.store(version.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+            }
+        }
+
+        bucket& modify(size_type idx)
+        {
+            // Buckets are modified in probe order: a segment comes back right
+            // away, or as the first one once the probe wrapped around
+            const size_type seg = idx >> SEGMENT_SHIFT;
+            if (m_segments.empty() || (m_segments.back() != seg && m_segments.front() != seg))
+            {
+                auto& version = m_table.m_versions[seg];
+                version.store(version.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_release);
+                m_segments.push_back(seg);
+            }
+            return m_table.m_buckets[idx];
+        }
+
+    private:
+        table&                 m_table;
+        std::vector<size_type> m_segments;
+    };
+
+    bool insert_locked(const key_type &key, const mapped_type &value, bool assign)
+    {
+        const std::size_t hash = hash_key(key);
+        table* t = m_table.load(std::memory_order_relaxed);
+
+        const size_type found = find_idx(*t, key, hash);
+        if (found != t->m_capacity)
+        {
+            if (assign)
+            {
+                write_section section(*t);
+                store(section.modify(found), key, value);
+            }
+            return false;
+        }
+
+        if (size() + 1 > t->m_capacity * DEFAULT_MAX_LOAD_FACTOR)
+        {
+            grow(t->m_capacity * 2);
+            t = m_table.load(std::memory_order_relaxed);
+        }
+
+        if (m_long_probes)
+        {
+            check_displacement(*t, hash);
+        }
+
+        write_section section(*t);
+        m_long_probes |= insert_unique(*t, key, value, hash, &section);
+        m_size.store(size() + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Throws before anything changes if inserting hash would push a bucket
+    // past MAX_DISTANCE: the buckets from its slot to the next empty one move
+    // by one. Only needed once a distance reached DIST_LIMIT
+    static void check_displacement(const table& t, std::size_t hash)
+    {
+        size_type idx  = hash & (t.m_capacity - 1);
+        size_type dist = 0;
+        for (; !t.m_buckets[idx].m_info.empty() && t.m_buckets[idx].m_info.distance() >= dist;
+             idx = probe_next(t, idx), ++dist)
+        { }
+
+        if (dist > details::MAX_DISTANCE)
+        {
+            throw_probe_overflow();
+        }
+        for (; !t.m_buckets[idx].m_info.empty(); idx = probe_next(t, idx))
+        {
+            if (t.m_buckets[idx].m_info.distance() >= details::MAX_DISTANCE)
+            {
+                throw_probe_overflow();
+            }
+        }
+    }
+
+    [[noreturn]] static void throw_probe_overflow()
+    {
+        throw std::length_error("seqlock_hash_map: too many keys with the same hash");
+    }
+
+    // Robin Hood placement, section is null while the table is not published.
+    // Returns true if a distance reached DIST_LIMIT. Published tables are
+    // checked first, only an unpublished one can get the length_error
+    static bool insert_unique(table& t, key_type key, mapped_type value,
+                              std::size_t hash, write_section* section)
+    {
+        bool far = false;
+        bucket_info carried;
+        carried.set_distance(0);
+
+        for (size_type idx = hash & (t.m_capacity - 1); ; idx = probe_next(t, idx))
+        {
+            bucket& b = section ? section->modify(idx) : t.m_buckets[idx];
+            if (b.m_info.empty())
+            {
+                store(b, key, value);
+                b.m_info = carried;
+                return far;
+            }
+
+            if (b.m_info.distance() < carried.distance())
+            {
+                key_type    owner_key   = load_key(b);
+                mapped_type owner_value = load_value(b);
+                bucket_info owner_info  = b.m_info;
+
+                store(b, key, value);
+                b.m_info = carried;
+
+                key     = owner_key;
+                value   = owner_value;
+                carried = owner_info;
+            }
+
+            if (carried.distance() == details::MAX_DISTANCE)
+            {
+                throw_probe_overflow();
+            }
+            carried.set_distance(carried.distance() + 1);
+            far |= carried.distance() + 1 >= details::DIST_LIMIT;
+        }
+    }
+
+    template <typename K>
+    size_type erase_locked(const K &key)
+    {
+        table& t = *m_table.load(std::memory_order_relaxed);
+
+        size_type bucket_idx = find_idx(t, key, hash_key(key));
+        if (bucket_idx == t.m_capacity)
+        {
+            return 0;
+        }
+
+        write_section section(t);
+        for (size_type idx = probe_next(t, bucket_idx); ; idx = probe_next(t, idx))
+        {
+            const bucket& next = t.m_buckets[idx];
+            if (next.m_info.empty() || next.m_info.distance() == 0)
+            {
+                section.modify(bucket_idx).m_info.clear();
+                break;
+            }
+
+            bucket& b = section.modify(bucket_idx);
+            std::memcpy(b.m_key, next.m_key, sizeof(Key));
+            std::memcpy(b.m_value, next.m_value, sizeof(T));
+            b.m_info = next.m_info;
+            b.m_info.set_distance(next.m_info.distance() - 1);
+            bucket_idx = idx;
+        }
+
+        m_size.store(size() - 1, std::memory_order_relaxed);
+        return 1;
+    }
+
+    void grow(size_type capacity)
+    {
+        const table& old = *m_table.load(std::memory_order_relaxed);
+        std::unique_ptr<table> next(new table(capacity));
+
+        bool far = false;
+        for (size_type idx = 0; idx < old.m_capacity; ++idx)
+        {
+            const bucket& b = old.m_buckets[idx];
+            if (!b.m_info.empty())
+            {
+                const key_type key = load_key(b);
+                far |= insert_unique(*next, key, load_value(b), hash_key(key), nullptr);
+            }
+        }
+
+        publish(next.get());
+        next.release();
+        m_long_probes = far;
+    }
+
+    // Makes every segment odd, empties the buckets, then makes them even
+    // again: no lookup sees a half cleared table
+    static void clear_locked(table& t) noexcept
+    {
+        const size_type segments = (t.m_capacity + SEGMENT_SIZE - 1) / SEGMENT_SIZE;
+        for (size_type seg = 0; seg < segments; ++seg)
+        {
+            t.m_versions[seg].store(t.m_versions[seg].load(std::memory_order_relaxed) + 1,
+                                    std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (size_type idx = 0; idx < t.m_capacity; ++idx)
+        {
+            t.m_buckets[idx].m_info.clear();
+        }
+
+        for (size_type seg = 0; seg < segments; ++seg)
+        {
+            t.m_versions[seg].store(t.m_versions[seg].load(std::memory_order_relaxed) + 1,
+                                    std::memory_order_release);
+        }
+    }
+
+    // Only the reserve may throw, before next is published
+    void publish(table* next)
+    {
+        m_retired.reserve(m_retired.size() + 1);
+        m_retired.emplace_back(m_table.exchange(next, std::memory_order_seq_cst));
+        collect_locked();
+    }
+
+    // Tables retired before the last phase flip wait for the readers of the
+    // old phase, the ones retired since wait for the next flip
+    bool collect_locked()
+    {
+        if (!m_waiting.empty())
+        {
+            if (!readers_left(m_phase.load(std::memory_order_relaxed) ^ 1))
+            {
+                m_waiting.clear();
+            }
+        }
+
+        if (m_waiting.empty() && !m_retired.empty())
+        {
+            m_waiting.swap(m_retired);
+            const unsigned old_phase = m_phase.load(std::memory_order_relaxed);
+            m_phase.store(old_phase ^ 1, std::memory_order_seq_cst);
+            if (!readers_left(old_phase))
+            {
+                m_waiting.clear();
+            }
+        }
+
+        return m_waiting.empty() && m_retired.empty();
+    }
+
+    bool readers_left(unsigned phase) const noexcept
+    {
+        for (const reader_slot& slot : m_readers)
+        {
+            if (slot.m_readers[phase].load(std::memory_order_seq_cst) != 0)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static size_type probe_next(const table& t, size_type idx) noexcept
+    {
+        return idx + 1 < t.m_capacity ? idx + 1 : 0;
+    }
+
+    static size_type normalize_capacity(size_type count) noexcept
+    {
+        return details::power_of_two_growth_policy<>::compute_closest_capacity(
+            std::max(count, details::power_of_two_growth_policy<>::minimum_capacity()));
+    }
+
+    static size_type reader_index() noexcept
+    {
+        static std::atomic<size_type> next_index{0};
+        thread_local const size_type index =
+            next_index.fetch_add(1, std::memory_order_relaxed) % READER_SLOTS;
+        return index;
+    }
+
+private:
+    std::atomic<table*>                 m_table;
+    std::atomic<size_type>              m_size{0};
+    mutable std::mutex                  m_write_mutex;
+    std::vector<std::unique_ptr<table>> m_retired;
+    std::vector<std::unique_ptr<table>> m_waiting;
+    std::atomic<unsigned>               m_phase{0};
+    // A distance reached DIST_LIMIT, inserts check the probe run first
+    bool                                m_long_probes = false;
+    mutable reader_slot                 m_readers[READER_SLOTS];
+};
+}
@@ -0,0 +1,651 @@
+/**
+ * @file serialization.h
+ * @author jian wu (jian.wu_93@foxmail.com)
+ * @brief Streaming save and load of maps and sets to a std::ostream or a
+ * file descriptor, for keys and values which mapped_hash_map can't take.
+ *
+ * The stream is a stream_header (magic, version, compression, byte order,
+ * key and value sizes, element count), then the elements one after the
+ * other, each key followed by its mapped value. Lengths and trivially
+ * copyable types are written in host byte order, load() fails on a stream
+ * written with another byte order or other key or value sizes. It reads
+ * the count first and reserves the map once, for SERIALIZE_RESERVE_LIMIT
+ * elements at most: the count isn't trusted, bigger maps grow as their
+ * elements are read.
+ *
+ * Elements go through a Serializer with
+ *   template <typename Writer, typename U> void save(Writer &out, const U &value) const;
+ *   template <typename Reader, typename U> void load(Reader &in, U &value) const;
+ * calling out.write(data, bytes) and in.read(data, bytes). jw::serializer
+ * copies trivially copyable types as bytes, and std::basic_string,
+ * std::vector and std::pair as a length and their elements.
+ *
+ * Writes are gathered in blocks of SERIALIZE_BUFFER_SIZE bytes, each one
+ * stored behind its raw and stored sizes and the last one empty, so load()
+ * stops right after the map. With compression::zlib, available when
+ * JW_HAVE_ZLIB is defined (cmake option HASH_MAP_ZLIB), every block is
+ * deflated on its own.
+ *
+ * Works with any map which has size(), reserve(), clear() and
+ * emplace(key, value), or emplace(key) for a set.
+ *
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <unistd.h>
+#define JW_HAVE_FD_IO 1
+#endif
+
+#ifdef JW_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace jw
+{
+
+static constexpr const std::uint32_t SERIALIZE_VERSION     = 2;
+static constexpr const std::size_t   SERIALIZE_BUFFER_SIZE = std::size_t{1} << 20;
+
+// Elements reserved by load() before any of them is read
+static constexpr const std::size_t SERIALIZE_RESERVE_LIMIT = std::size_t{1} << 20;
+
+enum class compression : std::uint32_t
+{
+    none = 0,
+    zlib = 1,
+};
+
+namespace details
+{
+
+static constexpr const char          SERIALIZE_MAGIC[8]    = {'J', 'W', 'H', 'S', 'E', 'R', 0, 0};
+static constexpr const std::uint32_t SERIALIZE_BYTE_ORDER = 0x01020304;
+
+/**
+ * @brief First bytes of a jw::save stream. key_size and value_size are the
+ * sizes of trivially copyable key and mapped types, 0 for other types and
+ * for the value of a set.
+ */
+struct stream_header
+{
+    char          magic[8];
+    std::uint32_t version;
+    std::uint32_t compression;
+    std::uint32_t byte_order;
+    std::uint32_t reserved;
+    std::uint64_t key_size;
+    std::uint64_t value_size;
+    std::uint64_t size;
+};
+
+template <typename T, template <typename...> class Template>
+struct is_specialization : std::false_type
+{ };
+
+template <template <typename...> class Template, typename... Args>
+struct is_specialization<Template<Args...>, Template> : std::true_type
+{ };
+
+template <typename T, typename = void>
+struct has_mapped_type : std::false_type
+{ };
+
+template <typename T>
+struct has_mapped_type<T, std::void_t<typename T::mapped_type>> : std::true_type
+{ };
+
+template <typename>
+struct dependent_false : std::false_type
+{ };
+
+template <typename U>
+constexpr std::uint64_t stream_type_size() noexcept
+{
+    return std::is_trivially_copyable<U>::value ? sizeof(U) : 0;
+}
+
+template <typename Map>
+constexpr std::uint64_t stream_value_size() noexcept
+{
+    if constexpr (has_mapped_type<Map>::value)
+    {
+        return stream_type_size<typename Map::mapped_type>();
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+class ostream_sink
+{
+public:
+    explicit ostream_sink(std::ostream &out) : m_out(out) { }
+
+    void put(const void* data, std::size_t bytes)
+    {
+        if (!m_out.write(static_cast<const char*>(data), static_cast<std::streamsize>(bytes)))
+        {
+            throw std::runtime_error("jw::save: write failed");
+        }
+    }
+
+private:
+    std::ostream &m_out;
+};
+
+class istream_source
+{
+public:
+    explicit istream_source(std::istream &in) : m_in(in) { }
+
+    // Reads up to bytes, less only at the end of the stream
+    std::size_t get(void* data, std::size_t bytes)
+    {
+        m_in.read(static_cast<char*>(data), static_cast<std::streamsize>(bytes));
+        if (m_in.bad())
+        {
+            throw std::runtime_error("jw::load: read failed");
+        }
+        return static_cast<std::size_t>(m_in.gcount());
+    }
+
+private:
+    std::istream &m_in;
+};
+
+#ifdef JW_HAVE_FD_IO
+class fd_sink
+{
+public:
+    explicit fd_sink(int fd) : m_fd(fd) { }
+
+    void put(const void* data, std::size_t bytes)
+    {
+        const char* p = static_cast<const char*>(data);
+        while (bytes != 0)
+        {
+            const ssize_t n = ::write(m_fd, p, bytes);
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n <= 0)
+            {
+                throw std::runtime_error("jw::save: write failed");
+            }
+            p     += n;
+            bytes -= static_cast<std::size_t>(n);
+        }
+    }
+
+private:
+    int m_fd;
+};
+
+class fd_source
+{
+public:
+    explicit fd_source(int fd) : m_fd(fd) { }
+
+    std::size_t get(void* data, std::size_t bytes)
+    {
+        char*       p    = static_cast<char*>(data);
+        std::size_t done = 0;
+        while (done < bytes)
+        {
+            const ssize_t n = ::read(m_fd, p + done, bytes - done);
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n < 0)
+            {
+                throw std::runtime_error("jw::load: read failed");
+            }
+            if (n == 0)
+            {
+                break;
+            }
+            done += static_cast<std::size_t>(n);
+        }
+        return done;
+    }
+
+private:
+    int m_fd;
+};
+#endif
+
+/**
+ * @brief Gathers writes in blocks of up to SERIALIZE_BUFFER_SIZE bytes, each
+ * behind its raw and stored sizes, deflated with compression::zlib. finish()
+ * ends the stream with an empty block, so a reader stops right after it.
+ */
+template <typename Sink>
+class block_writer
+{
+public:
+    block_writer(Sink sink, compression mode) : m_sink(sink), m_mode(mode)
+    {
+        m_buffer.resize(SERIALIZE_BUFFER_SIZE);
+    }
+
+    void write(const void* data, std::size_t bytes)
+    {
+        const char* p = static_cast<const char*>(data);
+        while (bytes != 0)
+        {
+            // Big raw writes skip the copy into the buffer
+            if (m_used == 0 && bytes >= m_buffer.size() && m_mode == compression::none)
+            {
+                put_block(p, m_buffer.size());
+                p     += m_buffer.size();
+                bytes -= m_buffer.size();
+                continue;
+            }
+
+            const std::size_t n = std::min(bytes, m_buffer.size() - m_used);
+            std::memcpy(m_buffer.data() + m_used, p, n);
+            m_used += n;
+            p      += n;
+            bytes  -= n;
+            if (m_used == m_buffer.size())
+            {
+                flush();
+            }
+        }
+    }
+
+    void finish()
+    {
+        flush();
+        put_sizes(0, 0);
+    }
+
+private:
+    void flush()
+    {
+        if (m_used != 0)
+        {
+            put_block(m_buffer.data(), m_used);
+            m_used = 0;
+        }
+    }
+
+    void put_block(const char* data, std::size_t bytes)
+    {
+        if (m_mode == compression::none)
+        {
+            put_sizes(bytes, bytes);
+            m_sink.put(data, bytes);
+            return;
+        }
+
+#ifdef JW_HAVE_ZLIB
+        uLongf packed = compressBound(static_cast<uLong>(bytes));
+        m_packed.resize(packed);
+        if (compress2(reinterpret_cast<Bytef*>(m_packed.data()), &packed,
+                      reinterpret_cast<const Bytef*>(data), static_cast<uLong>(bytes), Z_BEST_SPEED) != Z_OK)
+        {
+            throw std::runtime_error("jw::save: compression failed");
+        }
+        put_sizes(bytes, packed);
+        m_sink.put(m_packed.data(), packed);
+#endif
+    }
+
+    void put_sizes(std::size_t raw, std::size_t stored)
+    {
+        const std::uint32_t sizes[2] = {static_cast<std::uint32_t>(raw), static_cast<std::uint32_t>(stored)};
+        m_sink.put(sizes, sizeof(sizes));
+    }
+
+    Sink              m_sink;
+    compression       m_mode;
+    std::vector<char> m_buffer;
+    std::vector<char> m_packed;
+    std::size_t       m_used = 0;
+};
+
+template <typename Source>
+class block_reader
+{
+public:
+    block_reader(Source source, compression mode) : m_source(source), m_mode(mode)
+    {
+        m_buffer.resize(SERIALIZE_BUFFER_SIZE);
+    }
+
+    void read(void* data, std::size_t bytes)
+    {
+        char* p = static_cast<char*>(data);
+        while (bytes != 0)
+        {
+            if (m_pos == m_end)
+            {
+                const block_sizes sizes = next_block();
+                if (sizes.raw == 0)
+                {
+                    throw std::runtime_error("jw::load: unexpected end of input");
+                }
+
+                // Big raw reads skip the copy out of the buffer
+                if (m_mode == compression::none && sizes.raw <= bytes)
+                {
+                    get_exact(p, sizes.raw);
+                    p     += sizes.raw;
+                    bytes -= sizes.raw;
+                    continue;
+                }
+                fill(sizes);
+            }
+
+            const std::size_t n = std::min(bytes, m_end - m_pos);
+            std::memcpy(p, m_buffer.data() + m_pos, n);
+            m_pos += n;
+            p     += n;
+            bytes -= n;
+        }
+    }
+
+    // Reads the empty block closing the stream
+    void finish()
+    {
+        if (m_pos != m_end || next_block().raw != 0)
+        {
+            throw std::runtime_error("jw::load: trailing data");
+        }
+    }
+
+private:
+    struct block_sizes
+    {
+        std::uint32_t raw;
+        std::uint32_t stored;
+    };
+
+    block_sizes next_block()
+    {
+        block_sizes sizes;
+        get_exact(&sizes, sizeof(sizes));
+        if (sizes.raw > m_buffer.size() || (m_mode == compression::none && sizes.stored != sizes.raw))
+        {
+            throw std::runtime_error("jw::load: corrupted block");
+        }
+        return sizes;
+    }
+
+    void fill(const block_sizes &sizes)
+    {
+        m_pos = 0;
+        m_end = sizes.raw;
+        if (m_mode == compression::none)
+        {
+            get_exact(m_buffer.data(), sizes.raw);
+            return;
+        }
+
+#ifdef JW_HAVE_ZLIB
+        m_packed.resize(sizes.stored);
+        get_exact(m_packed.data(), sizes.stored);
+
+        uLongf raw = sizes.raw;
+        if (uncompress(reinterpret_cast<Bytef*>(m_buffer.data()), &raw,
+                       reinterpret_cast<const Bytef*>(m_packed.data()), sizes.stored) != Z_OK ||
+            raw != sizes.raw)
+        {
+            throw std::runtime_error("jw::load: corrupted block");
+        }
+#endif
+    }
+
+    void get_exact(void* data, std::size_t bytes)
+    {
+        if (m_source.get(data, bytes) != bytes)
+        {
+            throw std::runtime_error("jw::load: unexpected end of input");
+        }
+    }
+
+    Source            m_source;
+    compression       m_mode;
+    std::vector<char> m_buffer;
+    std::vector<char> m_packed;
+    std::size_t       m_pos = 0;
+    std::size_t       m_end = 0;
+};
+
+}
+
+/**
+ * @brief Default element serializer: trivially copyable types as bytes,
+ * strings and vectors as their length and elements, pairs member by member.
+ */
+struct serializer
+{
+    template <typename Writer, typename U>
+    void save(Writer &out, const U &value) const
+    {
+        if constexpr (std::is_trivially_copyable<U>::value)
+        {
+            out.write(&value, sizeof(U));
+        }
+        else if constexpr (details::is_specialization<U, std::basic_string>::value ||
+                           details::is_specialization<U, std::vector>::value)
+        {
+            using elem_type = typename U::value_type;
+
+            const std::uint64_t size = value.size();
+            out.write(&size, sizeof(size));
+            if constexpr (std::is_trivially_copyable<elem_type>::value)
+            {
+                out.write(value.data(), value.size() * sizeof(elem_type));
+            }
+            else
+            {
+                for (const elem_type &elem : value)
+                {
+                    save(out, elem);
+                }
+            }
+        }
+        else if constexpr (details::is_specialization<U, std::pair>::value)
+        {
+            save(out, value.first);
+            save(out, value.second);
+        }
+        else
+        {
+            static_assert(details::dependent_false<U>::value,
+                          "jw::serializer doesn't know this type, pass a Serializer for it");
+        }
+    }
+
+    template <typename Reader, typename U>
+    void load(Reader &in, U &value) const
+    {
+        if constexpr (std::is_trivially_copyable<U>::value)
+        {
+            in.read(&value, sizeof(U));
+        }
+        else if constexpr (details::is_specialization<U, std::basic_string>::value ||
+                           details::is_specialization<U, std::vector>::value)
+        {
+            using elem_type = typename U::value_type;
+
+            std::uint64_t size = 0;
+            in.read(&size, sizeof(size));
+            value.resize(static_cast<std::size_t>(size));
+            if constexpr (std::is_trivially_copyable<elem_type>::value)
+            {
+                in.read(value.data(), value.size() * sizeof(elem_type));
+            }
+            else
+            {
+                for (elem_type &elem : value)
+                {
+                    load(in, elem);
+                }
+            }
+        }
+        else if constexpr (details::is_specialization<U, std::pair>::value)
+        {
+            load(in, value.first);
+            load(in, value.second);
+        }
+        else
+        {
+            static_assert(details::dependent_false<U>::value,
+                          "jw::serializer doesn't know this type, pass a Serializer for it");
+        }
+    }
+};
+
+namespace details
+{
+
+inline void check_compression(compression mode)
+{
+#ifndef JW_HAVE_ZLIB
+    if (mode == compression::zlib)
+    {
+        throw std::invalid_argument("jw: zlib compression needs JW_HAVE_ZLIB (cmake -DHASH_MAP_ZLIB=ON)");
+    }
+#endif
+    if (mode != compression::none && mode != compression::zlib)
+    {
+        throw std::invalid_argument("jw: unknown compression");
+    }
+}
+
+template <typename Map, typename Sink, typename Serializer>
+void save_to(const Map &map, Sink sink, compression mode, const Serializer &ser)
+{
+    check_compression(mode);
+
+    stream_header header{};
+    std::memcpy(header.magic, SERIALIZE_MAGIC, sizeof(header.magic));
+    header.version     = SERIALIZE_VERSION;
+    header.compression = static_cast<std::uint32_t>(mode);
+    header.byte_order  = SERIALIZE_BYTE_ORDER;
+    header.key_size    = stream_type_size<typename Map::key_type>();
+    header.value_size  = stream_value_size<Map>();
+    header.size        = map.size();
+    sink.put(&header, sizeof(header));
+
+    block_writer<Sink> out(sink, mode);
+    for (const auto &elem : map)
+    {
+        if constexpr (has_mapped_type<Map>::value)
+        {
+            ser.save(out, elem.first);
+            ser.save(out, elem.second);
+        }
+        else
+        {
+            ser.save(out, elem);
+        }
+    }
+    out.finish();
+}
+
+template <typename Map, typename Source, typename Serializer>
+void load_from(Map &map, Source source, const Serializer &ser)
+{
+    stream_header header;
+    if (source.get(&header, sizeof(header)) != sizeof(header) ||
+        std::memcmp(header.magic, SERIALIZE_MAGIC, sizeof(header.magic)) != 0)
+    {
+        throw std::runtime_error("jw::load: not a jw::save stream");
+    }
+    if (header.version != SERIALIZE_VERSION)
+    {
+        throw std::runtime_error("jw::load: unknown version " + std::to_string(header.version));
+    }
+    if (header.byte_order != SERIALIZE_BYTE_ORDER)
+    {
+        throw std::runtime_error("jw::load: stream written with another byte order");
+    }
+    if (header.key_size != stream_type_size<typename Map::key_type>() ||
+        header.value_size != stream_value_size<Map>())
+    {
+        throw std::runtime_error("jw::load: stream written with other key or value types");
+    }
+
+    const compression mode = static_cast<compression>(header.compression);
+    check_compression(mode);
+
+    map.clear();
+    map.reserve(static_cast<std::size_t>(std::min<std::uint64_t>(header.size, SERIALIZE_RESERVE_LIMIT)));
+
+    block_reader<Source> in(source, mode);
+    for (std::uint64_t i = 0; i < header.size; ++i)
+    {
+        typename Map::key_type key;
+        ser.load(in, key);
+        if constexpr (has_mapped_type<Map>::value)
+        {
+            typename Map::mapped_type value;
+            ser.load(in, value);
+            map.emplace(std::move(key), std::move(value));
+        }
+        else
+        {
+            map.emplace(std::move(key));
+        }
+    }
+    in.finish();
+}
+
+}
+
+template <typename Map, typename Serializer = serializer>
+void save(const Map &map, std::ostream &out, compression mode = compression::none,
+          const Serializer &ser = Serializer())
+{
+    details::save_to(map, details::ostream_sink(out), mode, ser);
+    out.flush();
+}
+
+// Replaces the elements of map with the ones of the stream
+template <typename Map, typename Serializer = serializer>
+void load(Map &map, std::istream &in, const Serializer &ser = Serializer())
+{
+    details::load_from(map, details::istream_source(in), ser);
+}
+
+#ifdef JW_HAVE_FD_IO
+template <typename Map, typename Serializer = serializer>
+void save(const Map &map, int fd, compression mode = compression::none,
+          const Serializer &ser = Serializer())
+{
+    details::save_to(map, details::fd_sink(fd), mode, ser);
+}
+
+template <typename Map, typename Serializer = serializer>
+void load(Map &map, int fd, const Serializer &ser = Serializer())
+{
+    details::load_from(map, details::fd_source(fd), ser);
+}
+#endif
+
+}
@@ -0,0 +1,556 @@
+/**
+ * @file sharded_hash_map.h
+ * @author jian wu (jian.wu_93@foxmail.com)
+ * @brief Thread safe hash map made of independent jw::hash_map shards.
+ *
+ * A key is routed to a shard by the high bits of its (remixed) hash, every
+ * shard has its own lock and cache line, so threads working on different
+ * shards never contend. With a shared mutex (the default) lookups of the same
+ * shard run in parallel.
+ *
+ * No reference into the map outlives a lock: find() returns a copy of the
+ * mapped value, visit() runs a function on it while the shard is locked.
+ *
+ * The allocator must be thread safe. An allocator placing memory on a NUMA
+ * node (jw::numa_allocator, or a jw::count::count_allocator over it) gets the
+ * shards dealt round robin over the nodes, shard_node() and node_of() tell
+ * where the table of a shard or a key lives. Keys go to shards by hash,
+ * so a thread still finds most keys on the other nodes: read-mostly maps
+ * can be copied on every node with jw::replicated_hash_map instead.
+ *
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <shared_mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#ifdef __SSE2__
+#include <emmintrin.h> // _mm_pause
+#endif
+
+#include "hash_map.h"
+#include "numa_allocator.h"
+
+namespace jw
+{
+
+static constexpr const std::size_t DEFAULT_SHARD_COUNT = 64;
+
+/**
+ * @brief Test and test-and-set lock, for shards which are held very briefly
+ */
+class spinlock
+{
+public:
+    void lock() noexcept
+    {
+        for (unsigned spins = 0; ; ++spins)
+        {
+            if (!m_locked.exchange(true, std::memory_order_acquire))
+            {
+                return;
+            }
+
+            while (m_locked.load(std::memory_order_relaxed))
+            {
+                pause(spins);
+            }
+        }
+    }
+
+    bool try_lock() noexcept
+    {
+        return !m_locked.load(std::memory_order_relaxed) &&
+               !m_locked.exchange(true, std::memory_order_acquire);
+    }
+
+    void unlock() noexcept
+    {
+        m_locked.store(false, std::memory_order_release);
+    }
+
+private:
+    static void pause(unsigned spins) noexcept
+    {
+        if (spins < 64)
+        {
+#ifdef __SSE2__
+            _mm_pause();
+#endif
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    std::atomic<bool> m_locked{false};
+};
+
+namespace details
+{
+
+template <typename Mutex, typename = void>
+struct is_shared_mutex : std::false_type
+{ };
+
+template <typename Mutex>
+struct is_shared_mutex<Mutex, std::void_t<decltype(std::declval<Mutex&>().lock_shared())>>
+    : std::true_type
+{ };
+
+// Readers share the lock when the mutex supports it
+template <typename Mutex>
+using read_lock = std::conditional_t<is_shared_mutex<Mutex>::value,
+                                     std::shared_lock<Mutex>,
+                                     std::unique_lock<Mutex>>;
+
+/**
+ * @brief Array of count elements built in place by make(i), for elements
+ * which can't be default constructed then assigned, e.g. shards whose map
+ * must keep the allocator it was built with
+ */
+template <typename T>
+class fixed_array
+{
+public:
+    template <typename Make>
+    fixed_array(std::size_t count, Make &&make)
+        : m_data(static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(alignof(T)))))
+    {
+        try
+        {
+            for (; m_size < count; ++m_size)
+            {
+                new (m_data + m_size) T(make(m_size));
+            }
+        }
+        catch (...)
+        {
+            destroy();
+            throw;
+        }
+    }
+
+    fixed_array(const fixed_array&)            = delete;
+    fixed_array& operator=(const fixed_array&) = delete;
+
+    ~fixed_array()
+    {
+        destroy();
+    }
+
+    T& operator[](std::size_t i) noexcept
+    {
+        return m_data[i];
+    }
+
+    const T& operator[](std::size_t i) const noexcept
+    {
+        return m_data[i];
+    }
+
+private:
+    void destroy() noexcept
+    {
+        while (m_size > 0)
+        {
+            m_data[--m_size].~T();
+        }
+        ::operator delete(m_data, std::align_val_t(alignof(T)));
+    }
+
+    T*          m_data;
+    std::size_t m_size = 0;
+};
+
+// Fibonacci hashing, spreads the hash bits into the high bits of the result,
+// so shards are picked independently of the low bits used by the shard itself
+inline std::size_t shard_hash(std::size_t hash) noexcept
+{
+    return static_cast<std::size_t>(static_cast<std::uint64_t>(hash) * 0x9E3779B97F4A7C15ull);
+}
+
+}
+
+template <typename Key,
+          typename T,
+          typename Hash         = std::hash<Key>,
+          typename KeyEqual     = std::equal_to<void>,
+          typename Allocator    = std::allocator<std::pair<Key, T>>,
+          typename Mutex        = std::shared_mutex,
+          typename GrowthPolicy = details::power_of_two_growth_policy<>,
+          bool StoreHash        = false>
+class sharded_hash_map
+{
+public:
+    using map_type       = hash_map<Key, T, Hash, KeyEqual, Allocator, GrowthPolicy, StoreHash>;
+    using key_type       = typename map_type::key_type;
+    using mapped_type    = typename map_type::mapped_type;
+    using value_type     = typename map_type::value_type;
+    using size_type      = typename map_type::size_type;
+    using hasher         = typename map_type::hasher;
+    using key_equal      = typename map_type::key_equal;
+    using allocator_type = typename map_type::allocator_type;
+    using mutex_type     = Mutex;
+
+private:
+    using read_lock  = details::read_lock<mutex_type>;
+    using write_lock = std::unique_lock<mutex_type>;
+
+    // Heterogeneous lookup needs both Hash (which also picks the shard) and
+    // KeyEqual transparent, as in jw::hash_map. key_type itself takes the
+    // plain overloads
+    template <typename K>
+    static constexpr bool is_transparent_key = details::is_transparent<Hash>::value &&
+        details::is_transparent<KeyEqual>::value && !std::is_same<K, key_type>::value;
+
+    template <typename K>
+    using enable_if_transparent = std::enable_if_t<is_transparent_key<K>, int>;
+
+    // The map is built with its allocator: allocators which don't propagate
+    // on swap or assignment can't be handed to a default constructed one
+    struct alignas(CACHE_LINE_SIZE) shard
+    {
+        shard(size_type bucket_count, const key_type &empty_key, const allocator_type &alloc, int node)
+            : m_map(bucket_count, empty_key, alloc), m_node(node)
+        { }
+
+        mutable mutex_type m_mutex;
+        map_type           m_map;
+        int                m_node;
+    };
+
+public:
+    sharded_hash_map() : sharded_hash_map(DEFAULT_SHARD_COUNT)
+    { }
+
+    /**
+     * @param shard_count rounded up to a power of 2
+     * @param bucket_count initial bucket count of the whole map
+     */
+    explicit sharded_hash_map(size_type shard_count,
+                              size_type bucket_count = 0,
+                              key_type empty_key = key_type(),
+                              const allocator_type &alloc = allocator_type())
+        : m_shard_count(details::power_of_two_growth_policy<>::compute_closest_capacity(
+                            std::max<size_type>(shard_count, 1))),
+          m_shards(m_shard_count, [&](size_type i)
+          {
+              const size_type shard_buckets = std::max(bucket_count / m_shard_count, GrowthPolicy::minimum_capacity());
+              const int       nodes         = details::has_on_node<allocator_type>::value ? numa_node_count() : 0;
+              const int       node          = nodes > 0 ? static_cast<int>(i % nodes) : NO_NUMA_NODE;
+              return shard(shard_buckets, empty_key, details::allocator_on_node(alloc, node), node);
+          })
+    {
+        while ((size_type{1} << m_shard_bits) < m_shard_count)
+        {
+            ++m_shard_bits;
+        }
+    }
+
+    sharded_hash_map(const sharded_hash_map&)            = delete;
+    sharded_hash_map& operator=(const sharded_hash_map&) = delete;
+
+    // Capacity
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    // Sum of the shard sizes, each shard is locked in turn so the result is
+    // not a snapshot under concurrent writes
+    size_type size() const
+    {
+        size_type total = 0;
+        for (size_type i = 0; i < m_shard_count; ++i)
+        {
+            read_lock lock(m_shards[i].m_mutex);
+            total += m_shards[i].m_map.size();
+        }
+        return total;
+    }
+
+    size_type shard_count() const noexcept
+    {
+        return m_shard_count;
+    }
+
+    // Modifiers
+    void clear()
+    {
+        for (size_type i = 0; i < m_shard_count; ++i)
+        {
+            write_lock lock(m_shards[i].m_mutex);
+            m_shards[i].m_map.clear();
+        }
+    }
+
+    // Returns true if the value was inserted
+    bool insert(const value_type &value)
+    {
+        return emplace(value.first, value.second);
+    }
+
+    bool insert(value_type &&value)
+    {
+        return emplace(value.first, std::move(value.second));
+    }
+
+    template <typename... Args>
+    bool emplace(const key_type &key, Args &&... args)
+    {
+        shard& s = shard_for(key);
+        write_lock lock(s.m_mutex);
+        return s.m_map.emplace(key, std::forward<Args>(args)...).second;
+    }
+
+    // Returns true if the value was inserted, false if it was assigned
+    template <typename M>
+    bool insert_or_assign(const key_type &key, M &&obj)
+    {
+        shard& s = shard_for(key);
+        write_lock lock(s.m_mutex);
+        return s.m_map.insert_or_assign(key, std::forward<M>(obj)).second;
+    }
+
+    size_type erase(const key_type &key)
+    {
+        return erase_impl(key);
+    }
+
+    template <typename K, enable_if_transparent<K> = 0>
+    size_type erase(const K &x)
+    {
+        return erase_impl(x);
+    }
+
+    // Lookup
+    std::optional<mapped_type> find(const key_type &key) const
+    {
+        return find_impl(key);
+    }
+
+    template <typename K, enable_if_transparent<K> = 0>
+    std::optional<mapped_type> find(const K &x) const
+    {
+        return find_impl(x);
+    }
+
+    size_type count(const key_type &key) const
+    {
+        return count_impl(key);
+    }
+
+    template <typename K, enable_if_transparent<K> = 0>
+    size_type count(const K &x) const
+    {
+        return count_impl(x);
+    }
+
+    // Calls fn(mapped_type&) with the shard of key locked, returns false if
+    // key is not in the map
+    template <typename F>
+    bool visit(const key_type &key, F &&fn)
+    {
+        return visit_impl(key, std::forward<F>(fn));
+    }
+
+    template <typename K, typename F, enable_if_transparent<K> = 0>
+    bool visit(const K &x, F &&fn)
+    {
+        return visit_impl(x, std::forward<F>(fn));
+    }
+
+    template <typename F>
+    bool visit(const key_type &key, F &&fn) const
+    {
+        return visit_impl(key, std::forward<F>(fn));
+    }
+
+    template <typename K, typename F, enable_if_transparent<K> = 0>
+    bool visit(const K &x, F &&fn) const
+    {
+        return visit_impl(x, std::forward<F>(fn));
+    }
+
+    // Calls fn(const value_type&) for every element, one shard locked at a time
+    template <typename F>
+    void visit_all(F &&fn) const
+    {
+        for (size_type i = 0; i < m_shard_count; ++i)
+        {
+            read_lock lock(m_shards[i].m_mutex);
+            for (const auto& value : m_shards[i].m_map)
+            {
+                fn(value);
+            }
+        }
+    }
+
+    // Hash policy
+    void reserve(size_type count)
+    {
+        const size_type per_shard = count / m_shard_count + 1;
+        for (size_type i = 0; i < m_shard_count; ++i)
+        {
+            write_lock lock(m_shards[i].m_mutex);
+            m_shards[i].m_map.reserve(per_shard);
+        }
+    }
+
+    void max_load_factor(float ml)
+    {
+        for (size_type i = 0; i < m_shard_count; ++i)
+        {
+            write_lock lock(m_shards[i].m_mutex);
+            m_shards[i].m_map.max_load_factor(ml);
+        }
+    }
+
+    // Observers
+    hasher hash_function() const
+    {
+        return hasher();
+    }
+
+    key_equal key_eq() const
+    {
+        return key_equal();
+    }
+
+    size_type shard_index(const key_type &key) const noexcept
+    {
+        return shard_index_impl(key);
+    }
+
+    template <typename K, enable_if_transparent<K> = 0>
+    size_type shard_index(const K &x) const noexcept
+    {
+        return shard_index_impl(x);
+    }
+
+    // NUMA node the table of shard is allocated on, NO_NUMA_NODE when the
+    // allocator doesn't place memory
+    int shard_node(size_type shard) const noexcept
+    {
+        return m_shards[shard].m_node;
+    }
+
+    int node_of(const key_type &key) const noexcept
+    {
+        return shard_for(key).m_node;
+    }
+
+    template <typename K, enable_if_transparent<K> = 0>
+    int node_of(const K &x) const noexcept
+    {
+        return shard_for(x).m_node;
+    }
+
+private:
+    template <typename K>
+    size_type shard_index_impl(const K &key) const noexcept
+    {
+        if (m_shard_bits == 0)
+        {
+            return 0;
+        }
+
+        const std::size_t mixed = details::shard_hash(hasher()(key));
+        return mixed >> (std::numeric_limits<std::size_t>::digits - m_shard_bits);
+    }
+
+    template <typename K>
+    shard& shard_for(const K &key) noexcept
+    {
+        return m_shards[shard_index_impl(key)];
+    }
+
+    template <typename K>
+    const shard& shard_for(const K &key) const noexcept
+    {
+        return m_shards[shard_index_impl(key)];
+    }
+
+    template <typename K>
+    size_type erase_impl(const K &key)
+    {
+        shard& s = shard_for(key);
+        write_lock lock(s.m_mutex);
+        return s.m_map.erase(key);
+    }
+
+    template <typename K>
+    std::optional<mapped_type> find_impl(const K &key) const
+    {
+        const shard& s = shard_for(key);
+        read_lock lock(s.m_mutex);
+
+        auto it = s.m_map.find(key);
+        if (it == s.m_map.end())
+        {
+            return std::nullopt;
+        }
+        return it->second;
+    }
+
+    template <typename K>
+    size_type count_impl(const K &key) const
+    {
+        const shard& s = shard_for(key);
+        read_lock lock(s.m_mutex);
+        return s.m_map.count(key);
+    }
+
+    template <typename K, typename F>
+    bool visit_impl(const K &key, F &&fn)
+    {
+        shard& s = shard_for(key);
+        write_lock lock(s.m_mutex);
+
+        auto it = s.m_map.find(key);
+        if (it == s.m_map.end())
+        {
+            return false;
+        }
+        fn(it->second);
+        return true;
+    }
+
+    template <typename K, typename F>
+    bool visit_impl(const K &key, F &&fn) const
+    {
+        const shard& s = shard_for(key);
+        read_lock lock(s.m_mutex);
+
+        auto it = s.m_map.find(key);
+        if (it == s.m_map.end())
+        {
+            return false;
+        }
+        fn(static_cast<const mapped_type&>(it->second));
+        return true;
+    }
+
+private:
+    size_type                   m_shard_count;
+    size_type                   m_shard_bits = 0;
+    details::fixed_array<shard> m_shards;
+};
+}
@@ -0,0 +1,579 @@
+/**
+ * @file small_hash_map.h
+ * @author jian wu (jian.wu_93@foxmail.com)
+ * @brief jw::hash_map with inline storage for its first N elements.
+ *
+ * Up to N elements live in an array inside the object and are found by a
+ * linear scan (KeyEqual only, no hashing), so a map which never holds more
+ * than N elements never allocates. Inserting the N+1-th element moves them all
+ * into a jw::hash_map, which the map keeps using until clear().
+ *
+ * Inserts and erases invalidate iterators, the spill moves every element.
+ *
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "hash_map.h"
+
+namespace jw
+{
+
+template <typename Key,
+          typename T,
+          std::size_t N         = 8,
+          typename Hash         = std::hash<Key>,
+          typename KeyEqual     = std::equal_to<void>,
+          typename Allocator    = std::allocator<std::pair<Key, T>>,
+          typename GrowthPolicy = details::power_of_two_growth_policy<>>
+class small_hash_map
+{
+    static_assert(N > 0, "small_hash_map needs inline room for one element at least");
+
+public:
+    using table           = hash_map<Key, T, Hash, KeyEqual, Allocator, GrowthPolicy>;
+    using key_type        = typename table::key_type;
+    using mapped_type     = typename table::mapped_type;
+    using value_type      = typename table::value_type;
+    using size_type       = typename table::size_type;
+    using hasher          = typename table::hasher;
+    using key_equal       = typename table::key_equal;
+    using allocator_type  = typename table::allocator_type;
+    using reference       = typename table::reference;
+    using const_reference = typename table::const_reference;
+
+    static constexpr const size_type INLINE_CAPACITY = N;
+
+    template <typename TableIter, typename IterVal>
+    struct small_iterator
+    {
+        using difference_type   = std::ptrdiff_t;
+        using value_type        = IterVal;
+        using pointer           = value_type*;
+        using reference         = value_type&;
+        using iterator_category = std::forward_iterator_tag;
+
+        bool operator==(const small_iterator &other) const
+        {
+            return other.ptr_ == ptr_ && other.it_ == it_;
+        }
+
+        bool operator!=(const small_iterator &other) const
+        {
+            return !(other == *this);
+        }
+
+        small_iterator &operator++()
+        {
+            if (it_)
+            {
+                ++*it_;
+            }
+            else
+            {
+                ++ptr_;
+            }
+            return *this;
+        }
+
+        reference operator*() const
+        {
+            return it_ ? **it_ : *ptr_;
+        }
+
+        pointer operator->() const
+        {
+            return &**this;
+        }
+
+    private:
+        explicit small_iterator(pointer ptr) : ptr_(ptr) { }
+        explicit small_iterator(TableIter it) : it_(it) { }
+
+        pointer                  ptr_ = nullptr;
+        std::optional<TableIter> it_;
+        friend small_hash_map;
+    };
+
+    using iterator       = small_iterator<typename table::iterator, value_type>;
+    using const_iterator = small_iterator<typename table::const_iterator, const value_type>;
+
+private:
+    using alloc_traits = std::allocator_traits<allocator_type>;
+
+    // Heterogeneous lookup needs a transparent Hash (the spilled table
+    // hashes K) as well as a transparent KeyEqual, as in jw::hash_map
+    template <typename K>
+    static constexpr bool is_transparent_key = details::is_transparent<Hash>::value &&
+        details::is_transparent<KeyEqual>::value &&
+        !std::is_convertible<K, iterator>::value && !std::is_convertible<K, const_iterator>::value;
+
+    template <typename K>
+    using enable_if_transparent = std::enable_if_t<is_transparent_key<K>, int>;
+
+    static constexpr bool NOTHROW_MOVE = std::is_nothrow_move_constructible<value_type>::value &&
+        std::is_nothrow_copy_constructible<key_type>::value && std::is_nothrow_copy_assignable<key_type>::value;
+
+public:
+    small_hash_map() : small_hash_map(key_type())
+    { }
+
+    // empty_key and alloc are only used once the map spills into a jw::hash_map
+    explicit small_hash_map(key_type empty_key, const allocator_type &alloc = allocator_type())
+        : m_empty_key(empty_key), m_alloc(alloc)
+    { }
+
+    small_hash_map(const small_hash_map &other)
+        : m_empty_key(other.m_empty_key),
+          m_alloc(alloc_traits::select_on_container_copy_construction(other.m_alloc)),
+          m_table(other.m_table)
+    {
+        for (size_type i = 0; i < other.m_inline_size; ++i)
+        {
+            new (slot(i)) value_type(*other.slot(i));
+            ++m_inline_size;
+        }
+    }
+
+    // Moves the inline elements one by one, and the table whole
+    small_hash_map(small_hash_map &&other) noexcept(NOTHROW_MOVE)
+        : m_empty_key(other.m_empty_key), m_alloc(other.m_alloc), m_table(std::move(other.m_table))
+    {
+        other.m_table.reset();
+        move_inline_from(other);
+    }
+
+    small_hash_map &operator=(const small_hash_map &other)
+    {
+        if (this != &other)
+        {
+            small_hash_map copy(other);
+            *this = std::move(copy);
+        }
+        return *this;
+    }
+
+    small_hash_map &operator=(small_hash_map &&other) noexcept(
+        NOTHROW_MOVE && std::is_nothrow_move_assignable<table>::value)
+    {
+        if (this != &other)
+        {
+            clear();
+            m_empty_key = other.m_empty_key;
+            if constexpr (alloc_traits::propagate_on_container_move_assignment::value)
+            {
+                m_alloc = other.m_alloc;
+            }
+            m_table = std::move(other.m_table);
+            other.m_table.reset();
+            move_inline_from(other);
+        }
+        return *this;
+    }
+
+    ~small_hash_map()
+    {
+        destroy_inline();
+    }
+
+    allocator_type get_allocator() const noexcept
+    {
+        return m_alloc;
+    }
+
+    // Iterators
+    iterator begin() noexcept
+    {
+        return m_table ? iterator(m_table->begin()) : iterator(slot(0));
+    }
+
+    const_iterator begin() const noexcept
+    {
+        return m_table ? const_iterator(m_table->cbegin()) : const_iterator(slot(0));
+    }
+
+    const_iterator cbegin() const noexcept
+    {
+        return begin();
+    }
+
+    iterator end() noexcept
+    {
+        return m_table ? iterator(m_table->end()) : iterator(slot(m_inline_size));
+    }
+
+    const_iterator end() const noexcept
+    {
+        return m_table ? const_iterator(m_table->cend()) : const_iterator(slot(m_inline_size));
+    }
+
+    const_iterator cend() const noexcept
+    {
+        return end();
+    }
+
+    // Capacity
+    bool empty() const noexcept
+    {
+        return size() == 0;
+    }
+
+    size_type size() const noexcept
+    {
+        return m_table ? m_table->size() : m_inline_size;
+    }
+
+    size_type max_size() const noexcept
+    {
+        return m_table ? m_table->max_size() : std::allocator_traits<allocator_type>::max_size(m_alloc) / 2;
+    }
+
+    // True once the elements moved into the jw::hash_map
+    bool spilled() const noexcept
+    {
+        return m_table.has_value();
+    }
+
+    // Modifiers
+    // Releases the table, the map is back to inline storage
+    void clear() noexcept
+    {
+        destroy_inline();
+        m_table.reset();
+    }
+
+    std::pair<iterator, bool> insert(const value_type &value)
+    {
+        return emplace_impl(value.first, value.second);
+    }
+
+    std::pair<iterator, bool> insert(value_type &&value)
+    {
+        return emplace_impl(value.first, std::move(value.second));
+    }
+
+    template <typename... Args>
+    std::pair<iterator, bool> emplace(const key_type &key, Args &&... args)
+    {
+        return emplace_impl(key, std::forward<Args>(args)...);
+    }
+
+    void erase(iterator it)
+    {
+        if (it.it_)
+        {
+            m_table->erase(*it.it_);
+        }
+        else
+        {
+            erase_inline(static_cast<size_type>(it.ptr_ - slot(0)));
+        }
+    }
+
+    // The spilled table only erases by iterator, its bucket is found again
+    void erase(const_iterator it)
+    {
+        if (it.it_)
+        {
+            m_table->erase(m_table->find((*it.it_)->first));
+        }
+        else
+        {
+            erase_inline(static_cast<size_type>(it.ptr_ - slot(0)));
+        }
+    }
+
+    size_type erase(const key_type &key)
+    {
+        return erase_impl(key);
+    }
+
+    template <typename K, enable_if_transparent<K> = 0>
+    size_type erase(const K &x)
+    {
+        return erase_impl(x);
+    }
+
+    // The inline elements trade places pairwise, the extra ones of the
+    // larger map move over
+    void swap(small_hash_map &other) noexcept(
+        NOTHROW_MOVE && std::is_nothrow_swappable<value_type>::value && std::is_nothrow_swappable<table>::value)
+    {
+        using std::swap;
+        if (this == &other)
+        {
+            return;
+        }
+
+        small_hash_map &larger  = m_inline_size >= other.m_inline_size ? *this : other;
+        small_hash_map &smaller = m_inline_size >= other.m_inline_size ? other : *this;
+        for (size_type i = 0; i < smaller.m_inline_size; ++i)
+        {
+            swap(*slot(i), *other.slot(i));
+        }
+        for (size_type i = smaller.m_inline_size; i < larger.m_inline_size; ++i)
+        {
+            new (smaller.slot(i)) value_type(std::move(*larger.slot(i)));
+            larger.slot(i)->~value_type();
+        }
+
+        swap(m_inline_size, other.m_inline_size);
+        swap(m_empty_key, other.m_empty_key);
+        if constexpr (alloc_traits::propagate_on_container_swap::value)
+        {
+            swap(m_alloc, other.m_alloc);
+        }
+        swap(m_table, other.m_table);
+    }
+
+    // Lookup
+    mapped_type &at(const key_type &key)
+    {
+        return at_impl(key);
+    }
+
+    template <typename K, enable_if_transparent<K> = 0>
+    mapped_type &at(const K &x)
+    {
+        return at_impl(x);
+    }
+
+    const mapped_type &at(const key_type &key) const
+    {
+        return const_cast<small_hash_map*>(this)->at_impl(key);
+    }
+
+    template <typename K, enable_if_transparent<K> = 0>
+    const mapped_type &at(const K &x) const
+    {
+        return const_cast<small_hash_map*>(this)->at_impl(x);
+    }
+
+    mapped_type &operator[](const key_type &key)
+    {
+        return emplace_impl(key).first->second;
+    }
+
+    size_type count(const key_type &key) const
+    {
+        return find(key) == end() ? 0 : 1;
+    }
+
+    template <typename K, enable_if_transparent<K> = 0>
+    size_type count(const K &x) const
+    {
+        return find(x) == end() ? 0 : 1;
+    }
+
+    iterator find(const key_type &key)
+    {
+        return find_impl(key);
+    }
+
+    template <typename K, enable_if_transparent<K> = 0>
+    iterator find(const K &x)
+    {
+        return find_impl(x);
+    }
+
+    const_iterator find(const key_type &key) const
+    {
+        return find_impl(key);
+    }
+
+    template <typename K, enable_if_transparent<K> = 0>
+    const_iterator find(const K &x) const
+    {
+        return find_impl(x);
+    }
+
+    // Hash policy
+    // Spills right away if count doesn't fit inline
+    void reserve(size_type count)
+    {
+        if (m_table)
+        {
+            m_table->reserve(count);
+        }
+        else if (count > N)
+        {
+            spill(count);
+        }
+    }
+
+    // Observers
+    hasher hash_function() const
+    {
+        return hasher();
+    }
+
+    key_equal key_eq() const
+    {
+        return key_equal();
+    }
+
+private:
+    value_type* slot(size_type idx) noexcept
+    {
+        return std::launder(reinterpret_cast<value_type*>(m_inline)) + idx;
+    }
+
+    const value_type* slot(size_type idx) const noexcept
+    {
+        return std::launder(reinterpret_cast<const value_type*>(m_inline)) + idx;
+    }
+
+    template <typename K>
+    iterator find_impl(const K &key)
+    {
+        if (m_table)
+        {
+            return iterator(m_table->find(key));
+        }
+        return iterator(slot(find_inline(key)));
+    }
+
+    template <typename K>
+    const_iterator find_impl(const K &key) const
+    {
+        if (m_table)
+        {
+            return const_iterator(m_table->find(key));
+        }
+        return const_iterator(slot(find_inline(key)));
+    }
+
+    template <typename K>
+    mapped_type &at_impl(const K &key)
+    {
+        iterator it = find_impl(key);
+        if (it != end())
+        {
+            return it->second;
+        }
+        throw std::out_of_range("small_hash_map::at");
+    }
+
+    template <typename K>
+    size_type erase_impl(const K &key)
+    {
+        if (m_table)
+        {
+            return m_table->erase(key);
+        }
+
+        const size_type idx = find_inline(key);
+        if (idx == m_inline_size)
+        {
+            return 0;
+        }
+        erase_inline(idx);
+        return 1;
+    }
+
+    template <typename K>
+    size_type find_inline(const K &key) const
+    {
+        for (size_type i = 0; i < m_inline_size; ++i)
+        {
+            if (key_equal()(slot(i)->first, key))
+            {
+                return i;
+            }
+        }
+        return m_inline_size;
+    }
+
+    template <typename... Args>
+    std::pair<iterator, bool> emplace_impl(const key_type &key, Args &&... args)
+    {
+        if (!m_table)
+        {
+            const size_type idx = find_inline(key);
+            if (idx != m_inline_size)
+            {
+                return {iterator(slot(idx)), false};
+            }
+
+            if (m_inline_size < N)
+            {
+                new (slot(m_inline_size)) value_type(std::piecewise_construct,
+                                                     std::forward_as_tuple(key),
+                                                     std::forward_as_tuple(std::forward<Args>(args)...));
+                return {iterator(slot(m_inline_size++)), true};
+            }
+
+            spill(2 * N);
+        }
+
+        auto res = m_table->emplace(key, std::forward<Args>(args)...);
+        return {iterator(res.first), res.second};
+    }
+
+    // Moves the inline elements into a table sized for count elements
+    void spill(size_type count)
+    {
+        table t(GrowthPolicy::minimum_capacity(), m_empty_key, m_alloc);
+        t.reserve(std::max(count, m_inline_size));
+        for (size_type i = 0; i < m_inline_size; ++i)
+        {
+            t.emplace(slot(i)->first, std::move(slot(i)->second));
+        }
+
+        destroy_inline();
+        m_table.emplace(std::move(t));
+    }
+
+    // Keeps the inline elements contiguous
+    void erase_inline(size_type idx)
+    {
+        const size_type last = m_inline_size - 1;
+        if (idx != last)
+        {
+            slot(idx)->~value_type();
+            new (slot(idx)) value_type(std::move(*slot(last)));
+        }
+        slot(last)->~value_type();
+        --m_inline_size;
+    }
+
+    void move_inline_from(small_hash_map &other)
+    {
+        for (size_type i = 0; i < other.m_inline_size; ++i)
+        {
+            new (slot(i)) value_type(std::move(*other.slot(i)));
+            ++m_inline_size;
+        }
+        other.destroy_inline();
+    }
+
+    void destroy_inline() noexcept
+    {
+        for (size_type i = 0; i < m_inline_size; ++i)
+        {
+            slot(i)->~value_type();
+        }
+        m_inline_size = 0;
+    }
+
+private:
+    alignas(value_type) unsigned char m_inline[N * sizeof(value_type)];
+    size_type                         m_inline_size = 0;
+    key_type                          m_empty_key;
+    allocator_type                    m_alloc;
+    std::optional<table>              m_table;
+};
+}
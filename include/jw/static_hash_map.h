@@ -0,0 +1,327 @@
+/**
+ * @file static_hash_map.h
+ * @author jian wu (jian.wu_93@foxmail.com)
+ * @brief Immutable map built at compile time with a perfect hash.
+ *
+ * The N values are kept in the order given. Keys are spread over N / 2
+ * groups by their hash, and every group gets the first displacement which
+ * sends all its keys to free slots of a table of the power of two above
+ * 2 * N, groups with the most keys first (hash and displace). A lookup is
+ * then one hash, one displacement and one slot: a single key comparison, no
+ * probing.
+ *
+ * Everything is constexpr given a constexpr hasher such as jw::static_hash,
+ * e.g. protocol opcodes:
+ *
+ *   constexpr auto opcodes = jw::make_static_hash_map<std::string_view, int>({
+ *       {"get", 1}, {"set", 2}, {"del", 3}});
+ *   static_assert(opcodes.at("set") == 2);
+ *
+ * Duplicate keys fail the build, or throw std::invalid_argument when built
+ * at run time.
+ *
+ * @version 0.1
+ * @date 2026-10-14
+ *
+ *
+ */
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+namespace jw
+{
+
+// Displacements tried for a group before giving up
+static constexpr const std::uint32_t STATIC_MAX_DISPLACEMENT = std::uint32_t{1} << 20;
+
+namespace details
+{
+
+constexpr std::uint64_t static_mix(std::uint64_t h) noexcept
+{
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+constexpr std::size_t static_capacity(std::size_t count) noexcept
+{
+    std::size_t capacity = 1;
+    while (capacity < 2 * count)
+    {
+        capacity <<= 1;
+    }
+    return capacity;
+}
+
+}
+
+/**
+ * @brief constexpr hasher of integral, enum and string keys for
+ * static_hash_map: a 64 bits finalizer for integers, FNV-1a for strings.
+ */
+template <typename Key, typename = void>
+struct static_hash;
+
+template <typename Key>
+struct static_hash<Key, std::enable_if_t<std::is_integral<Key>::value || std::is_enum<Key>::value>>
+{
+    constexpr std::size_t operator()(Key key) const noexcept
+    {
+        return static_cast<std::size_t>(details::static_mix(static_cast<std::uint64_t>(key)));
+    }
+};
+
+template <>
+struct static_hash<std::string_view>
+{
+    using is_transparent = void;
+
+    constexpr std::size_t operator()(std::string_view str) const noexcept
+    {
+        std::uint64_t h = 0xCBF29CE484222325ull;
+        for (char c : str)
+        {
+            h = (h ^ static_cast<unsigned char>(c)) * 0x100000001B3ull;
+        }
+        return static_cast<std::size_t>(h);
+    }
+};
+
+template <typename Key,
+          typename T,
+          std::size_t N,
+          typename Hash     = static_hash<Key>,
+          typename KeyEqual = std::equal_to<void>>
+class static_hash_map
+{
+    static_assert(N > 0, "static_hash_map needs one value at least");
+
+public:
+    using key_type        = Key;
+    using mapped_type     = T;
+    using value_type      = std::pair<Key, T>;
+    using size_type       = std::size_t;
+    using hasher          = Hash;
+    using key_equal       = KeyEqual;
+    using const_reference = const value_type &;
+    using const_iterator  = const value_type*;
+    using iterator        = const_iterator;
+
+    static constexpr const size_type CAPACITY = details::static_capacity(N);
+    static constexpr const size_type GROUPS   = N / 2 + 1;
+
+    // Slots hold the index of their value plus one, 0 when free
+    using slot_type = std::conditional_t<(N < 0xFFFF), std::uint16_t, std::uint32_t>;
+
+public:
+    constexpr explicit static_hash_map(const value_type (&values)[N])
+        : static_hash_map(values, std::make_index_sequence<N>())
+    { }
+
+    // Iterators, in the order of the values given
+    constexpr const_iterator begin() const noexcept
+    {
+        return m_values.data();
+    }
+
+    constexpr const_iterator cbegin() const noexcept
+    {
+        return begin();
+    }
+
+    constexpr const_iterator end() const noexcept
+    {
+        return m_values.data() + N;
+    }
+
+    constexpr const_iterator cend() const noexcept
+    {
+        return end();
+    }
+
+    // Capacity
+    constexpr bool empty() const noexcept
+    {
+        return N == 0;
+    }
+
+    constexpr size_type size() const noexcept
+    {
+        return N;
+    }
+
+    // Lookup
+    template <typename K>
+    constexpr const mapped_type &at(const K &key) const
+    {
+        const_iterator it = find(key);
+        if (it == end())
+        {
+            throw std::out_of_range("static_hash_map::at");
+        }
+        return it->second;
+    }
+
+    template <typename K>
+    constexpr size_type count(const K &key) const
+    {
+        return find(key) == end() ? 0 : 1;
+    }
+
+    template <typename K>
+    constexpr const_iterator find(const K &key) const
+    {
+        const std::size_t hash = hasher()(key);
+        const slot_type   slot = m_slots[slot_of(hash, m_displacements[group_of(hash)])];
+        if (slot != 0 && key_equal()(m_values[slot - 1].first, key))
+        {
+            return begin() + (slot - 1);
+        }
+        return end();
+    }
+
+    // Bucket interface
+    constexpr size_type bucket_count() const noexcept
+    {
+        return CAPACITY;
+    }
+
+    // Observers
+    constexpr hasher hash_function() const
+    {
+        return hasher();
+    }
+
+    constexpr key_equal key_eq() const
+    {
+        return key_equal();
+    }
+
+private:
+    template <std::size_t... I>
+    constexpr static_hash_map(const value_type (&values)[N], std::index_sequence<I...>)
+        : m_values{{values[I]...}}
+    {
+        build();
+    }
+
+    static constexpr size_type group_of(std::size_t hash) noexcept
+    {
+        return static_cast<size_type>(hash % GROUPS);
+    }
+
+    static constexpr size_type slot_of(std::size_t hash, std::uint32_t displacement) noexcept
+    {
+        return static_cast<size_type>(
+            details::static_mix(hash ^ (displacement * 0x9E3779B97F4A7C15ull)) & (CAPACITY - 1));
+    }
+
+    // Places the groups from the largest down, each at the first
+    // displacement which sends all its keys to free slots
+    constexpr void build()
+    {
+        std::size_t hashes[N]               = {};
+        size_type   group_sizes[GROUPS]     = {};
+        size_type   group_begin[GROUPS + 1] = {};
+        size_type   by_group[N]             = {};
+        size_type   max_group               = 0;
+
+        for (size_type i = 0; i < N; ++i)
+        {
+            hashes[i] = hasher()(m_values[i].first);
+            group_sizes[group_of(hashes[i])]++;
+        }
+
+        for (size_type g = 0; g < GROUPS; ++g)
+        {
+            group_begin[g + 1] = group_begin[g] + group_sizes[g];
+            max_group = group_sizes[g] > max_group ? group_sizes[g] : max_group;
+        }
+
+        size_type fill[GROUPS] = {};
+        for (size_type i = 0; i < N; ++i)
+        {
+            const size_type g = group_of(hashes[i]);
+            by_group[group_begin[g] + fill[g]++] = i;
+        }
+
+        for (size_type group_size = max_group; group_size > 0; --group_size)
+        {
+            for (size_type g = 0; g < GROUPS; ++g)
+            {
+                if (group_sizes[g] == group_size)
+                {
+                    place_group(hashes, by_group + group_begin[g], group_size, g);
+                }
+            }
+        }
+    }
+
+    constexpr void place_group(const std::size_t* hashes, const size_type* members,
+                               size_type count, size_type group)
+    {
+        for (size_type i = 0; i < count; ++i)
+        {
+            for (size_type j = i + 1; j < count; ++j)
+            {
+                if (key_equal()(m_values[members[i]].first, m_values[members[j]].first))
+                {
+                    throw std::invalid_argument("static_hash_map: duplicate key");
+                }
+            }
+        }
+
+        for (std::uint32_t displacement = 0; displacement < STATIC_MAX_DISPLACEMENT; ++displacement)
+        {
+            bool fits = true;
+            for (size_type i = 0; i < count && fits; ++i)
+            {
+                const size_type slot = slot_of(hashes[members[i]], displacement);
+                fits = m_slots[slot] == 0;
+
+                // Two keys of the group on the same slot
+                for (size_type j = 0; j < i && fits; ++j)
+                {
+                    fits = slot_of(hashes[members[j]], displacement) != slot;
+                }
+            }
+
+            if (fits)
+            {
+                for (size_type i = 0; i < count; ++i)
+                {
+                    m_slots[slot_of(hashes[members[i]], displacement)] = static_cast<slot_type>(members[i] + 1);
+                }
+                m_displacements[group] = displacement;
+                return;
+            }
+        }
+
+        throw std::invalid_argument("static_hash_map: no perfect hash found, keys with equal hashes?");
+    }
+
+private:
+    std::array<value_type, N>         m_values;
+    std::array<slot_type, CAPACITY>   m_slots{};
+    std::array<std::uint32_t, GROUPS> m_displacements{};
+};
+
+template <typename Key, typename T, typename Hash = static_hash<Key>, std::size_t N>
+constexpr static_hash_map<Key, T, N, Hash> make_static_hash_map(const std::pair<Key, T> (&values)[N])
+{
+    return static_hash_map<Key, T, N, Hash>(values);
+}
+
+}